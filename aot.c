@@ -0,0 +1,97 @@
+#include "aot.h"
+
+#include <stdlib.h>
+
+#include "cartridge.h"
+#include "gameboy.h"
+#include "logger.h"
+#include "processor.h"
+#include "scheduler.h"
+
+#if defined(TRTLE_AOT) && !defined(_WIN32)
+#include <dlfcn.h>
+#endif
+
+// FNV-1a, only used to pair a module with the ROM it was built from
+uint64_t aot_hash(void const * data, size_t size) {
+    uint8_t const * bytes = data;
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+#if defined(TRTLE_AOT) && !defined(_WIN32)
+
+// Returns NULL when there is no usable module for the cartridge, which just leaves the ROM interpreted
+Aot * aot_load(char const * path, Cartridge const * cart) {
+    if (path == NULL || cart == NULL) return NULL;
+
+    void * handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (handle == NULL) return NULL;
+
+    AotModule const * module = dlsym(handle, AOT_SYMBOL);
+    if (module == NULL || module->version != AOT_VERSION || module->layout != AOT_LAYOUT) {
+        TRTLE_LOG_WARN("AOT module %s was built for another version of the core\n", path);
+        dlclose(handle);
+        return NULL;
+    }
+    if (module->rom_size != cart->rom_size || module->rom_hash != aot_hash(cart->rom, cart->rom_size)) {
+        TRTLE_LOG_WARN("AOT module %s was built from another ROM\n", path);
+        dlclose(handle);
+        return NULL;
+    }
+
+    Aot * aot = malloc(sizeof(Aot));
+    if (aot == NULL) {
+        dlclose(handle);
+        return NULL;
+    }
+    aot->handle = handle;
+    aot->module = module;
+    aot->rom = cart->rom;
+    return aot;
+}
+
+void aot_unload(Aot * aot) {
+    if (aot == NULL) return;
+    dlclose(aot->handle);
+    free(aot);
+}
+
+// Points the op at index to its translation, if the module has one for where it was decoded from
+void aot_compile(GameBoy * const gb, ProcessorBlock * const block, size_t index) {
+    ProcessorOp * const op = &block->ops[index];
+    uint8_t const * code = block->code + (op->address - block->ops[0].address);
+    if (code < gb->aot->rom || code >= gb->aot->rom + gb->aot->module->rom_size) return;
+
+    uint32_t offset = code - gb->aot->rom;
+    AotEntry const * entries = gb->aot->module->entries;
+    size_t low = 0;
+    size_t high = gb->aot->module->entry_count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (entries[middle].offset < offset) low = middle + 1;
+        else high = middle;
+    }
+
+    // Bank 0 can show up elsewhere with MBC1, the translation only holds at its own address
+    if (low == gb->aot->module->entry_count || entries[low].offset != offset || entries[low].address != op->address) return;
+    op->native = entries[low].run;
+    op->native_entry = entries[low].entry;
+    op->native_cycles = entries[low].cycles;
+}
+
+#else
+
+Aot * aot_load(char const * path, Cartridge const * cart) {
+    return NULL;
+}
+
+void aot_unload(Aot * aot) {}
+
+void aot_compile(GameBoy * const gb, ProcessorBlock * const block, size_t index) {}
+
+#endif
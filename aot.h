@@ -0,0 +1,51 @@
+#ifndef TRTLE_AOT_H
+#define TRTLE_AOT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Modules sit next to the ROM, game.gb is paired with game.aot.so
+#define AOT_EXTENSION ".aot.so"
+#define AOT_SYMBOL    "trtle_aot_module"
+#define AOT_VERSION   (2)
+
+// Changes whenever a struct the generated code touches changes shape
+#define AOT_LAYOUT ((uint32_t)(sizeof(GameBoy) * 65599u + sizeof(Processor) * 257u + sizeof(Scheduler)))
+
+typedef struct Cartridge Cartridge;
+typedef struct GameBoy GameBoy;
+typedef struct ProcessorBlock ProcessorBlock;
+
+// A translated op, its function is entered at entry and follows the ProcessorOp native contract
+typedef struct AotEntry {
+    uint32_t offset;  // Offset of the op in the ROM image
+    uint16_t address; // Address the op was translated to run at
+    uint8_t entry;
+    uint8_t cycles;   // M-cycles of the longest pass from the op to its first budget check
+    size_t (*run)(GameBoy * const gb, size_t entry);
+} AotEntry;
+
+typedef struct AotModule {
+    uint32_t version;
+    uint32_t layout;
+    uint64_t rom_hash;
+    uint64_t rom_size;
+    size_t entry_count;
+    AotEntry const * entries; // Sorted by offset
+} AotModule;
+
+typedef struct Aot {
+    void * handle;
+    AotModule const * module;
+    uint8_t const * rom;
+} Aot;
+
+uint64_t aot_hash(void const * data, size_t size);
+
+Aot * aot_load(char const * path, Cartridge const * cart);
+void aot_unload(Aot * aot);
+
+void aot_compile(GameBoy * const gb, ProcessorBlock * const block, size_t index);
+
+#endif /* !TRTLE_AOT_H */
@@ -10,6 +10,9 @@
 #define MBC_CARTRIDGE_TYPE_ADDRESS (0x0147)
 #define MBC_ROM_SIZE_ADDRESS       (0x0148)
 #define MBC_RAM_SIZE_ADDRESS       (0x0149)
+#define MBC_TITLE_ADDRESS          (0x0134)
+#define MBC_TITLE_LENGTH           (16)
+#define MBC_CHECKSUM_ADDRESS       (0x014E)
 
 #define ROM_BANK_SIZE              (0x4000)
 #define RAM_BANK_SIZE              (0x2000)
@@ -26,6 +29,88 @@
 #define MBC5_ROMB1_MASK    (0b00000001)
 #define MBC5_RAMB_MASK     (0b00001111)
 
+// The ROM side of each MBC family, the accessors below are generated once per family and picked when
+// the cartridge is loaded, so none of them switch on its type
+typedef struct CartridgeHandlers {
+    uint8_t (*read_rom)(GameBoy const * const gb, uint16_t address);
+    void (*write_rom)(GameBoy * const gb, uint16_t address, uint8_t value);
+    void (*map_rom)(GameBoy const * const gb, uint8_t const * pages[CARTRIDGE_ROM_PAGE_COUNT]);
+} CartridgeHandlers;
+
+#define CARTRIDGE_FAMILIES(X) X(none) X(mbc1) X(mbc2) X(mbc5)
+
+static inline size_t cartridge_none_rom_bank(Cartridge const * const cart, bool high) {
+    return high ? 1 : 0;
+}
+
+static inline size_t cartridge_mbc1_rom_bank(Cartridge const * const cart, bool high) {
+    if (high) return (cart->romb1 << 5) | cart->romb0;
+    return cart->mode ? ((size_t)cart->romb1 << 5) : 0;
+}
+
+static inline size_t cartridge_mbc2_rom_bank(Cartridge const * const cart, bool high) {
+    return high ? cart->romb0 : 0;
+}
+
+static inline size_t cartridge_mbc5_rom_bank(Cartridge const * const cart, bool high) {
+    return high ? ((cart->romb1 << 8) | cart->romb0) : 0;
+}
+
+static inline void cartridge_none_write(Cartridge * const cart, uint16_t address, uint8_t value) {
+    TRTLE_LOG_INFO("Attempted to write to ROM with no MBC\n");
+}
+
+static inline void cartridge_mbc1_write(Cartridge * const cart, uint16_t address, uint8_t value) {
+    if (address <= 0x1FFF) cart->ramg = (value & MBC1_RAMG_MASK) == RAMG_ENABLE;
+    else if (address <= 0x3FFF) cart->romb0 = (value & MBC1_ROMB0_MASK) == 0 ? 1 : (value & MBC1_ROMB0_MASK);
+    else if (address <= 0x5FFF) cart->romb1 = value & MBC1_ROMB1_MASK;
+    else cart->mode = value & 1;
+}
+
+static inline void cartridge_mbc2_write(Cartridge * const cart, uint16_t address, uint8_t value) {
+    if (address <= 0x3FFF) {
+        if (!((address >> 8) & 1)) cart->ramg = (value & MBC2_RAMG_MASK) == RAMG_ENABLE;
+        else cart->romb0 = (value & MBC2_ROMB0_MASK) == 0 ? 1 : (value & MBC2_ROMB0_MASK);
+    }
+}
+
+static inline void cartridge_mbc5_write(Cartridge * const cart, uint16_t address, uint8_t value) {
+    if (address <= 0x1FFF) cart->ramg = value == RAMG_ENABLE;
+    else if (address <= 0x2FFF) cart->romb0 = value;
+    else if (address <= 0x3FFF) cart->romb1 = value & MBC5_ROMB1_MASK;
+    else if (address <= 0x5FFF) cart->ramb = value & MBC5_RAMB_MASK;
+}
+
+// Pages are only handed out when the ROM is a whole number of them, the rest is read through read_rom
+#define CARTRIDGE_FAMILY_HANDLERS(family)\
+static uint8_t cartridge_read_rom_##family(GameBoy const * const gb, uint16_t address) {\
+    Cartridge const * const cart = gb->cartridge;\
+    size_t rom_bank = cartridge_##family##_rom_bank(cart, address > 0x3FFF);\
+    return cart->rom[((rom_bank * ROM_BANK_SIZE) | (address & (ROM_BANK_SIZE - 1))) & (cart->rom_size - 1)];\
+}\
+\
+static void cartridge_write_rom_##family(GameBoy * const gb, uint16_t address, uint8_t value) {\
+    cartridge_##family##_write(gb->cartridge, address, value);\
+}\
+\
+static void cartridge_map_rom_##family(GameBoy const * const gb, uint8_t const * pages[CARTRIDGE_ROM_PAGE_COUNT]) {\
+    Cartridge const * const cart = gb->cartridge;\
+    bool const mapped = (cart->rom_size & 0xFF) == 0;\
+    size_t const low = cartridge_##family##_rom_bank(cart, false) * ROM_BANK_SIZE;\
+    size_t const high = cartridge_##family##_rom_bank(cart, true) * ROM_BANK_SIZE;\
+    for (size_t page = 0; page < CARTRIDGE_ROM_PAGE_COUNT; page++) {\
+        size_t bank = page < CARTRIDGE_ROM_PAGE_COUNT / 2 ? low : high;\
+        pages[page] = mapped ? &cart->rom[(bank | ((page << 8) & (ROM_BANK_SIZE - 1))) & (cart->rom_size - 1)] : NULL;\
+    }\
+}\
+\
+static CartridgeHandlers const cartridge_##family##_handlers = {\
+    cartridge_read_rom_##family,\
+    cartridge_write_rom_##family,\
+    cartridge_map_rom_##family\
+};
+CARTRIDGE_FAMILIES(CARTRIDGE_FAMILY_HANDLERS)
+
 static CartridgeError cartridge_setup_rom(Cartridge * const cart, const void * rom_data, size_t rom_len) {
     cart->rom = calloc(1, rom_len);
     memcpy(cart->rom, rom_data, rom_len);
@@ -97,6 +182,7 @@ CartridgeError cartridge_from_memory(Cartridge ** return_cart, const void * data
         case MBC_NONE:
         case MBC_NONE_RAM:
         case MBC_NONE_RAM_BATTERY: {
+            cart->handlers = &cartridge_none_handlers;
             cart->romb0 = 0;
             cart->romb1 = 0;
             cart->ramb = 0;
@@ -107,6 +193,7 @@ CartridgeError cartridge_from_memory(Cartridge ** return_cart, const void * data
         case MBC_MBC1:
         case MBC_MBC1_RAM:
         case MBC_MBC1_RAM_BATTERY: {
+            cart->handlers = &cartridge_mbc1_handlers;
             cart->romb0 = 1;
             cart->romb1 = 0;
             cart->ramb = 0;
@@ -116,6 +203,7 @@ CartridgeError cartridge_from_memory(Cartridge ** return_cart, const void * data
 
         case MBC_MBC2:
         case MBC_MBC2_BATTERY: {
+            cart->handlers = &cartridge_mbc2_handlers;
             cart->romb0 = 1;
             cart->romb1 = 0;
             cart->ramb = 0;
@@ -129,6 +217,7 @@ CartridgeError cartridge_from_memory(Cartridge ** return_cart, const void * data
         case MBC_MBC5_RUMBLE:
         case MBC_MBC5_RUMBLE_RAM:
         case MBC_MBC5_RUMBLE_RAM_BATTERY: {
+            cart->handlers = &cartridge_mbc5_handlers;
             cart->romb0 = 1;
             cart->romb1 = 0;
             cart->ramb = 0;
@@ -166,135 +255,31 @@ void cartridge_delete(Cartridge * cart) {
     }
 }
 
-static uint8_t cartridge_read_low(GameBoy const * const gb, uint16_t address) {
-    address &= 0x3FFF;
-    size_t size = gb->cartridge->rom_size - 1; // For address wrap
-    switch (gb->cartridge->type) {
-        case MBC_NONE:
-        case MBC_NONE_RAM:
-        case MBC_NONE_RAM_BATTERY: {
-            return gb->cartridge->rom[address & size];
-        } break;
-
-        case MBC_MBC1:
-        case MBC_MBC1_RAM:
-        case MBC_MBC1_RAM_BATTERY: {
-            size_t rom_bank = gb->cartridge->mode ? ((size_t)gb->cartridge->romb1 << 5) : 0;
-            return gb->cartridge->rom[((rom_bank * ROM_BANK_SIZE) | address) & size];
-        } break;
-
-        case MBC_MBC2:
-        case MBC_MBC2_BATTERY: {
-            return gb->cartridge->rom[address & size];
-        } break;
-
-        case MBC_MBC5:
-        case MBC_MBC5_RAM:
-        case MBC_MBC5_RAM_BATTERY:
-        case MBC_MBC5_RUMBLE:
-        case MBC_MBC5_RUMBLE_RAM:
-        case MBC_MBC5_RUMBLE_RAM_BATTERY: {
-            return gb->cartridge->rom[address & size];
-        } break;
-
-        default: {
-            TRTLE_LOG_ERR("Attempted to read from ROM with a Non-supported MBC");
-            return 0xFF;
-        } break;
+// Names a ROM for lists kept outside the core, the title stops at its padding or a CGB flag
+void cartridge_get_id(Cartridge const * const cart, char id[CARTRIDGE_ID_LENGTH]) {
+    if (cart->rom_size < MBC_CHECKSUM_ADDRESS + 2) {
+        id[0] = '\0';
+        return;
     }
-    TRTLE_LOG_ERR("Switch leaked during low external ROM read");
-}
-
-static uint8_t cartridge_read_high(GameBoy const * const gb, uint16_t address) {
-    address &= ROM_BANK_SIZE - 1;
-    size_t size = gb->cartridge->rom_size - 1; // For address wrap
-    switch (gb->cartridge->type) {
-        case MBC_NONE:
-        case MBC_NONE_RAM:
-        case MBC_NONE_RAM_BATTERY: {
-            return gb->cartridge->rom[((size_t)address + ROM_BANK_SIZE) & size];
-        } break;
-
-        case MBC_MBC1:
-        case MBC_MBC1_RAM:
-        case MBC_MBC1_RAM_BATTERY: {
-            size_t rom_bank = (gb->cartridge->romb1 << 5) | gb->cartridge->romb0;
-            return gb->cartridge->rom[((rom_bank * ROM_BANK_SIZE) | address) & size];
-        } break;
-
-        case MBC_MBC2:
-        case MBC_MBC2_BATTERY: {
-            return gb->cartridge->rom[((gb->cartridge->romb0 * ROM_BANK_SIZE) | address) & size];
-        } break;
-
-        case MBC_MBC5:
-        case MBC_MBC5_RAM:
-        case MBC_MBC5_RAM_BATTERY:
-        case MBC_MBC5_RUMBLE:
-        case MBC_MBC5_RUMBLE_RAM:
-        case MBC_MBC5_RUMBLE_RAM_BATTERY: {
-            size_t rom_bank = (gb->cartridge->romb1 << 8) | gb->cartridge->romb0;
-            return gb->cartridge->rom[((rom_bank * ROM_BANK_SIZE) | address) & size];
-        } break;
 
-        default: {
-            TRTLE_LOG_ERR("Attempted to read from ROM with a non-supported MBC");
-            return 0xFF;
-        } break;
+    uint16_t checksum = cart->rom[MBC_CHECKSUM_ADDRESS] << 8 | cart->rom[MBC_CHECKSUM_ADDRESS + 1];
+    int length = sprintf(id, "%04X ", checksum);
+    for (size_t i = 0; i < MBC_TITLE_LENGTH; i++) {
+        uint8_t c = cart->rom[MBC_TITLE_ADDRESS + i];
+        if (c < 0x20 || c >= 0x7F) break;
+        id[length++] = c;
     }
-    TRTLE_LOG_ERR("Switch leaked during high external ROM read");
+    while (id[length - 1] == ' ') length--;
+    id[length] = '\0';
 }
 
 uint8_t cartridge_read_rom(GameBoy const * const gb, uint16_t address) {
-    if (gb->cartridge != NULL) {
-        if (address <= 0x3FFF) return cartridge_read_low(gb, address);
-        else return cartridge_read_high(gb, address);
-    }
-
+    if (gb->cartridge != NULL) return gb->cartridge->handlers->read_rom(gb, address);
     return 0xFF;
 }
 
 void cartridge_write_rom(GameBoy * const gb, uint16_t address, uint8_t value) {
-    switch (gb->cartridge->type) {
-        case MBC_NONE:
-        case MBC_NONE_RAM:
-        case MBC_NONE_RAM_BATTERY: {
-            TRTLE_LOG_INFO("Attempted to write to ROM with no MBC\n");
-        } break;
-
-        case MBC_MBC1:
-        case MBC_MBC1_RAM:
-        case MBC_MBC1_RAM_BATTERY: {
-            if (address <= 0x1FFF) gb->cartridge->ramg = (value & MBC1_RAMG_MASK) == RAMG_ENABLE;
-            else if (address <= 0x3FFF) gb->cartridge->romb0 = (value & MBC1_ROMB0_MASK) == 0 ? 1 : (value & MBC1_ROMB0_MASK);
-            else if (address <= 0x5FFF) gb->cartridge->romb1 = value & MBC1_ROMB1_MASK;
-            else gb->cartridge->mode = value & 1;
-        } break;
-
-        case MBC_MBC2:
-        case MBC_MBC2_BATTERY: {
-            if (address <= 0x3FFF) {
-                if (!((address >> 8) & 1)) gb->cartridge->ramg = (value & MBC2_RAMG_MASK) == RAMG_ENABLE;
-                else gb->cartridge->romb0 = (value & MBC2_ROMB0_MASK) == 0 ? 1 : (value & MBC2_ROMB0_MASK);
-            }
-        } break;
-
-        case MBC_MBC5:
-        case MBC_MBC5_RAM:
-        case MBC_MBC5_RAM_BATTERY:
-        case MBC_MBC5_RUMBLE:
-        case MBC_MBC5_RUMBLE_RAM:
-        case MBC_MBC5_RUMBLE_RAM_BATTERY: {
-            if (address <= 0x1FFF) gb->cartridge->ramg = value == RAMG_ENABLE;
-            else if (address <= 0x2FFF) gb->cartridge->romb0 = value;
-            else if (address <= 0x3FFF) gb->cartridge->romb1 = value & MBC5_ROMB1_MASK;
-            else if (address <= 0x5FFF) gb->cartridge->ramb = value & MBC5_RAMB_MASK;
-        } break;
-
-        default: {
-            TRTLE_LOG_ERR("Attempted to write to ROM with a non-supported MBC");
-        } break;
-    }
+    gb->cartridge->handlers->write_rom(gb, address, value);
 }
 
 uint8_t cartridge_read_ram(GameBoy const * const gb, uint16_t address) {
@@ -393,3 +378,38 @@ void cartridge_write_ram(GameBoy * const gb, uint16_t address, uint8_t value) {
         } break;
     }
 }
+
+// Fills in the host memory backing each page of 0000-7FFF, or NULL where reads need to go through cartridge_read_rom
+void cartridge_map_rom(GameBoy const * const gb, uint8_t const * pages[CARTRIDGE_ROM_PAGE_COUNT]) {
+    if (gb->cartridge == NULL) {
+        for (size_t page = 0; page < CARTRIDGE_ROM_PAGE_COUNT; page++) pages[page] = NULL;
+        return;
+    }
+    gb->cartridge->handlers->map_rom(gb, pages);
+}
+
+// Returns the host memory backing the page at address, or NULL if accesses need to go through the MBC
+uint8_t * cartridge_get_ram_page(GameBoy const * const gb, uint16_t address) {
+    Cartridge * const cart = gb->cartridge;
+    if (cart == NULL || cart->ram == NULL || !cart->ramg || (cart->ram_size & 0xFF) != 0) return NULL;
+
+    size_t ram_bank;
+    switch (cart->type) {
+        case MBC_MBC1_RAM:
+        case MBC_MBC1_RAM_BATTERY: {
+            ram_bank = cart->mode ? cart->romb1 : 0;
+        } break;
+
+        case MBC_MBC5_RAM:
+        case MBC_MBC5_RAM_BATTERY:
+        case MBC_MBC5_RUMBLE_RAM:
+        case MBC_MBC5_RUMBLE_RAM_BATTERY: {
+            ram_bank = cart->ramb;
+        } break;
+
+        default: return NULL; // MBC2 has 4 bit ram and needs masking
+    }
+
+    address &= RAM_BANK_SIZE - 1;
+    return &cart->ram[((ram_bank * RAM_BANK_SIZE) | address) & (cart->ram_size - 1)];
+}
@@ -2,8 +2,15 @@
 #define TRTLE_CARTRIDGE_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+// Global checksum and title from the header, "XXXX TITLE" with a terminator
+#define CARTRIDGE_ID_LENGTH (22)
+
+#define CARTRIDGE_ROM_PAGE_COUNT (0x80)
+
+typedef struct CartridgeHandlers CartridgeHandlers;
 typedef struct GameBoy GameBoy;
 
 typedef enum CartridgeError {
@@ -50,6 +57,7 @@ typedef enum MBC {
 
 typedef struct Cartridge {
     MBC type;
+    CartridgeHandlers const * handlers; // Accessors generated for the MBC family of type
     uint8_t * rom;
     uint8_t * ram;
     size_t rom_size;
@@ -65,10 +73,15 @@ typedef struct Cartridge {
 CartridgeError cartridge_from_memory(Cartridge ** return_cart, const void * data, size_t size);
 void cartridge_delete(Cartridge * cart);
 
+void cartridge_get_id(Cartridge const * const cart, char id[CARTRIDGE_ID_LENGTH]);
+
 uint8_t cartridge_read_rom(GameBoy const* const gb, uint16_t address);
 void cartridge_write_rom(GameBoy* const gb, uint16_t address, uint8_t value);
 
 uint8_t cartridge_read_ram(GameBoy const* const gb, uint16_t address);
 void cartridge_write_ram(GameBoy* const gb, uint16_t address, uint8_t value);
 
+void cartridge_map_rom(GameBoy const * const gb, uint8_t const * pages[CARTRIDGE_ROM_PAGE_COUNT]);
+uint8_t * cartridge_get_ram_page(GameBoy const * const gb, uint16_t address);
+
 #endif /* !TRTLE_CARTRIDGE_H */
@@ -4,6 +4,7 @@
 #include "gameboy.h"
 #include "ppu.h"
 #include "processor.h"
+#include "scheduler.h"
 
 void dma_initialize(DMA * const dma, bool skip_bootrom) {
     dma->dma = 0xCC; // TODO: Make random
@@ -13,13 +14,15 @@ void dma_initialize(DMA * const dma, bool skip_bootrom) {
     dma->active = false;
 }
 
-void dma_cycle(GameBoy * const gb) {
+void dma_event(GameBoy * const gb) {
     if (gb->dma->queue != -1) {
         if (!gb->dma->delay) {
             gb->dma->dma = gb->dma->queue & 0xFF;
             gb->dma->queue = -1;
             gb->dma->current = 0x00;
             gb->dma->active = true;
+            gameboy_remap(gb);
+            gameboy_update_run_state(gb);
         }
         else gb->dma->delay = false;
     }
@@ -35,12 +38,23 @@ void dma_cycle(GameBoy * const gb) {
         gameboy_write(gb, GAMEBOY_OAM_ADDRESS | gb->dma->current, value);
         gb->dma->current++;
     }
-    else gb->dma->active = false;
+    else if (gb->dma->active) {
+        gb->dma->active = false;
+        gameboy_remap(gb);
+        gameboy_update_run_state(gb);
+    }
+
+    // Transfers move a byte per cycle, so keep ticking until the last one has landed
+    if (gb->dma->queue != -1 || gb->dma->active) {
+        scheduler_schedule(gb, SCHEDULER_EVENT_DMA, gb->scheduler->clock + 1);
+    }
 }
 
 void dma_write_dma(GameBoy * const gb, uint8_t value) {
     gb->dma->queue = value;
     gb->dma->delay = true;
+    scheduler_schedule(gb, SCHEDULER_EVENT_DMA, gb->scheduler->clock + 1);
+    gameboy_update_run_state(gb);
 }
 
 uint8_t dma_read_external_rom(GameBoy const * const gb, uint16_t address) {
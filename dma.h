@@ -16,7 +16,7 @@ typedef struct DMA {
 
 void dma_initialize(DMA * const dma, bool skip_bootrom);
 
-void dma_cycle(GameBoy * const gb);
+void dma_event(GameBoy * const gb);
 
 void dma_write_dma(GameBoy * const gb, uint8_t value);
 
@@ -2,13 +2,16 @@
 
 #include <stdlib.h>
 
+#include "aot.h"
 #include "cartridge.h"
 #include "dma.h"
 #include "interrupt_controller.h"
+#include "jit.h"
 #include "joypad.h"
 #include "logger.h"
 #include "ppu.h"
 #include "processor.h"
+#include "scheduler.h"
 #include "serial.h"
 #include "sound_controller.h"
 #include "timer.h"
@@ -34,6 +37,9 @@ static uint8_t dmg_boot[] = {
     0xF5, 0x06, 0x19, 0x78, 0x86, 0x23, 0x05, 0x20, 0xFB, 0x86, 0x20, 0xFE, 0x3E, 0x01, 0xE0, 0x50
 };
 
+static void gameboy_map_handlers(GameBoy * const gb);
+static void gameboy_map_cartridge(GameBoy * const gb);
+
 GameBoy * gameboy_create() {
     GameBoy * gb = calloc(1, sizeof(GameBoy));
 
@@ -43,6 +49,7 @@ GameBoy * gameboy_create() {
     gb->joypad = calloc(1, sizeof(Joypad));
     gb->ppu = calloc(1, sizeof(PPU));
     gb->processor = calloc(1, sizeof(Processor));
+    gb->scheduler = calloc(1, sizeof(Scheduler));
     gb->serial = calloc(1, sizeof(Serial));
     gb->sound_controller = calloc(1, sizeof(SoundController));
     gb->timer = calloc(1, sizeof(Timer));
@@ -54,10 +61,19 @@ GameBoy * gameboy_create() {
     joypad_initialize(gb->joypad, skip_bootrom);
     ppu_initialize(gb->ppu, skip_bootrom);
     processor_initialize(gb->processor, skip_bootrom);
+    scheduler_initialize(gb->scheduler, skip_bootrom);
     serial_initialize(gb->serial, skip_bootrom);
     sound_controller_initialize(gb->sound_controller, skip_bootrom);
     timer_initialize(gb->timer, skip_bootrom);
 
+    // Prime the scheduler with the first event of every running component
+    timer_event(gb);
+    ppu_event(gb);
+
+    gameboy_map_handlers(gb);
+    gameboy_remap(gb);
+    gameboy_update_run_state(gb);
+
     return gb;
 }
 
@@ -68,9 +84,16 @@ void gameboy_delete(GameBoy * const gb) {
         free(gb->joypad);
         free(gb->ppu);
         free(gb->processor);
+        free(gb->scheduler);
         free(gb->serial);
         free(gb->sound_controller);
         free(gb->timer);
+#ifdef TRTLE_JIT
+        jit_delete(gb->jit);
+#endif
+#ifdef TRTLE_AOT
+        aot_unload(gb->aot);
+#endif
 
         free(gb);
     }
@@ -83,13 +106,69 @@ void gameboy_reset(GameBoy * gb) {
     joypad_initialize(gb->joypad, skip_bootrom);
     ppu_initialize(gb->ppu, skip_bootrom);
     processor_initialize(gb->processor, skip_bootrom);
+    scheduler_initialize(gb->scheduler, skip_bootrom);
     serial_initialize(gb->serial, skip_bootrom);
     sound_controller_initialize(gb->sound_controller, skip_bootrom);
     timer_initialize(gb->timer, skip_bootrom);
+
+    timer_event(gb);
+    ppu_event(gb);
+
+    gameboy_remap(gb);
+    gameboy_update_run_state(gb);
 }
 
 void gameboy_set_cartridge(GameBoy * const gb, Cartridge * const cart) {
+#ifdef TRTLE_AOT
+    // A module only matches the ROM it was built from
+    aot_unload(gb->aot);
+    gb->aot = NULL;
+#endif
     gb->cartridge = cart;
+    processor_flush_blocks(gb);
+    gameboy_remap(gb);
+}
+
+// Returns whether the JIT ended up enabled, which it can't be unless built with TRTLE_JIT
+bool gameboy_set_jit(GameBoy * const gb, bool enabled) {
+#ifdef TRTLE_JIT
+    if (enabled == (gb->jit != NULL)) return enabled;
+
+    // Decoded blocks point into the code buffer
+    processor_flush_blocks(gb);
+    if (enabled) {
+        gb->jit = jit_create();
+    }
+    else {
+        jit_delete(gb->jit);
+        gb->jit = NULL;
+    }
+    return gb->jit != NULL;
+#else
+    return false;
+#endif
+}
+
+// Loads the module for the current cartridge, returning false when there is none or it doesn't match
+bool gameboy_load_aot(GameBoy * const gb, char const * path) {
+#ifdef TRTLE_AOT
+    aot_unload(gb->aot);
+    gb->aot = aot_load(path, gb->cartridge);
+
+    // Blocks decoded so far were never offered to the module
+    processor_flush_blocks(gb);
+    return gb->aot != NULL;
+#else
+    return false;
+#endif
+}
+
+// Instruction timing counts the M-cycles an instruction takes and charges them once it is done,
+// so events only ever fire between instructions. It gives up mid-instruction timing for fewer
+// stops, ROMs that pass trtle_timing lose nothing by it.
+void gameboy_set_instruction_timing(GameBoy * const gb, bool enabled) {
+    scheduler_charge(gb);
+    gb->instruction_timing = enabled;
 }
 
 void gameboy_update(GameBoy * const gb, GameBoyInput input) {
@@ -100,20 +179,93 @@ void gameboy_update(GameBoy * const gb, GameBoyInput input) {
 
     joypad_update_p1(gb, input);
     processor_process_instruction(gb);
+    if (gb->instruction_timing) scheduler_charge(gb);
+}
+
+// Picks the run loop variant from the halt, DMA and LCD state. Every change to one of them calls
+// this, so the variants themselves never test for the states they don't handle.
+void gameboy_update_run_state(GameBoy * const gb) {
+    if (gb->processor->halt_mode) gb->run_state = GAMEBOY_RUN_HALTED;
+    else if (gb->dma->queue != -1 || gb->dma->active) gb->run_state = GAMEBOY_RUN_DMA;
+    else if (!ppu_is_enabled(gb)) gb->run_state = GAMEBOY_RUN_LCD_OFF;
+    else gb->run_state = GAMEBOY_RUN_NORMAL;
 }
 
+// Runs ops on cached registers where it can. A cached run never reaches an event, so nothing
+// outside the processor changes during it. The LCD being off makes no difference to the CPU.
+static void gameboy_run_normal(GameBoy * const gb, uint64_t until, uint8_t state) {
+    while (gb->scheduler->clock < until && gb->run_state == state) {
+        if (processor_run_cached(gb, until)) continue;
+        processor_process_instruction(gb);
+        if (gb->instruction_timing) scheduler_charge(gb);
+    }
+}
+
+// A transfer schedules an event every cycle, which leaves no room for a cached run
+static void gameboy_run_dma(GameBoy * const gb, uint64_t until) {
+    while (gb->scheduler->clock < until && gb->run_state == GAMEBOY_RUN_DMA) {
+        processor_process_instruction(gb);
+        if (gb->instruction_timing) scheduler_charge(gb);
+    }
+}
+
+// Runs the variant for the current state up to until, returning early once the state changes
+static void gameboy_run(GameBoy * const gb, uint64_t until) {
+    switch (gb->run_state) {
+        case GAMEBOY_RUN_NORMAL:
+        case GAMEBOY_RUN_LCD_OFF: gameboy_run_normal(gb, until, gb->run_state); break;
+        case GAMEBOY_RUN_HALTED: processor_run_halted(gb, until); break;
+        case GAMEBOY_RUN_DMA: gameboy_run_dma(gb, until); break;
+    }
+}
+
+// The mode only changes on a PPU event, or on an LCDC write turning the LCD off or on, which
+// changes the run state. Runs go from one PPU event to the next, and with the LCD off a frame's
+// worth of cycles stands in for VBlank.
 void gameboy_update_to_vblank(GameBoy* const gb, GameBoyInput input) {
     if (gb == NULL) {
         TRTLE_LOG_ERR("Attempted to pass a null argument into gameboy_update_to_vblank");
         return;
     }
 
+    joypad_update_p1(gb, input);
+    uint64_t const frame_end = gb->scheduler->clock + GAMEBOY_FRAME_CYCLES;
     while (ppu_get_mode(gb) == GRAPHICS_MODE_VBLANK) {
-        gameboy_update(gb, input);
+        gameboy_run(gb, gb->scheduler->events[SCHEDULER_EVENT_PPU]);
     }
     while (ppu_get_mode(gb) != GRAPHICS_MODE_VBLANK) {
-        gameboy_update(gb, input);
+        if (ppu_is_enabled(gb)) gameboy_run(gb, gb->scheduler->events[SCHEDULER_EVENT_PPU]);
+        else if (gb->scheduler->clock < frame_end) gameboy_run(gb, frame_end);
+        else return;
+    }
+}
+
+// Runs whole instructions for at least the given M-cycles, returning how many actually ran
+uint64_t gameboy_run_cycles(GameBoy * const gb, GameBoyInput input, uint64_t cycles) {
+    if (gb == NULL) {
+        TRTLE_LOG_ERR("Attempted to pass a null argument into gameboy_run_cycles");
+        return 0;
+    }
+
+    joypad_update_p1(gb, input);
+    uint64_t const start = gb->scheduler->clock;
+    uint64_t const until = start + cycles;
+    while (gb->scheduler->clock < until) {
+        gameboy_run(gb, until);
     }
+    return gb->scheduler->clock - start;
+}
+
+// Runs until the scheduler clock reads exactly clock, stopping inside an instruction when that is
+// where it falls. The next update of any kind finishes the instruction before anything else.
+void gameboy_update_to_clock(GameBoy * const gb, GameBoyInput input, uint64_t clock) {
+    if (gb == NULL) {
+        TRTLE_LOG_ERR("Attempted to pass a null argument into gameboy_update_to_clock");
+        return;
+    }
+
+    joypad_update_p1(gb, input);
+    processor_run_to(gb, clock);
 }
 
 size_t gameboy_get_background_data(GameBoy const * const gb, uint32_t * data, size_t length) {
@@ -144,151 +296,315 @@ size_t gameboy_get_tileset_data(GameBoy const * const gb, uint32_t * data, size_
 }
 
 void gameboy_cycle(GameBoy * const gb) { 
-    dma_cycle(gb);
-    timer_cycle(gb);
-    ppu_cycle(gb);
+    if (gb->instruction_timing) gb->scheduler->owed += 1;
+    else if (++gb->scheduler->clock >= gb->scheduler->next) scheduler_run(gb);
 }
 
-uint8_t gameboy_read(GameBoy * const gb, uint16_t address) {
-    if      (address <= 0x00FF && !gb->boot) return dmg_boot[address];
-    else if (address <= 0x7FFF) return dma_read_external_rom(gb, address);
-    else if (address <= 0x9FFF) return dma_read_vram(gb, address - 0x8000);
-    else if (address <= 0xBFFF) return dma_read_external_ram(gb, address);
-    else if (address <= 0xDFFF) return gb->processor->ram[address - 0xC000];
-    else if (address <= 0xFDFF) return gb->processor->ram[address - 0xE000];      // Read from ECHO
-    else if (address <= 0xFE9F) return dma_read_oam(gb, address - 0xFE00); // Read from OAM
-    else if (address <= 0xFEFF) return 0x00;
-    else if (address == 0xFF00) return joypad_read_p1(gb);
-    else if (address == 0xFF01) return gb->serial->sb;
-    else if (address == 0xFF02) return serial_read_sc(gb);
-    else if (address == 0xFF03) return UNMAPPED_ALL_ONES;
-    else if (address == 0xFF04) return gb->timer->div;
-    else if (address == 0xFF05) return gb->timer->tima;
-    else if (address == 0xFF06) return gb->timer->tma;
-    else if (address == 0xFF07) return timer_read_tac(gb);
-    else if (address == 0xFF08) return UNMAPPED_ALL_ONES;
-    else if (address == 0xFF09) return UNMAPPED_ALL_ONES;
-    else if (address == 0xFF0A) return UNMAPPED_ALL_ONES;
-    else if (address == 0xFF0B) return UNMAPPED_ALL_ONES;
-    else if (address == 0xFF0C) return UNMAPPED_ALL_ONES;
-    else if (address == 0xFF0D) return UNMAPPED_ALL_ONES;
-    else if (address == 0xFF0E) return UNMAPPED_ALL_ONES;
-    else if (address == 0xFF0F) return interrupt_controller_get_flags(gb);
-    else if (address == 0xFF10) return sound_controller_read_nr10(gb);
-    else if (address == 0xFF11) return gb->sound_controller->nr11;
-    else if (address == 0xFF12) return gb->sound_controller->nr12;
-    else if (address == 0xFF13) return gb->sound_controller->nr13;
-    else if (address == 0xFF14) return gb->sound_controller->nr14;
-    else if (address == 0xFF15) return UNMAPPED_ALL_ONES;
-    else if (address == 0xFF16) return gb->sound_controller->nr21;
-    else if (address == 0xFF17) return gb->sound_controller->nr22;
-    else if (address == 0xFF18) return gb->sound_controller->nr23;
-    else if (address == 0xFF19) return gb->sound_controller->nr24;
-    else if (address == 0xFF1A) return sound_controller_read_nr30(gb);
-    else if (address == 0xFF1B) return gb->sound_controller->nr31;
-    else if (address == 0xFF1C) return sound_controller_read_nr32(gb);
-    else if (address == 0xFF1D) return gb->sound_controller->nr33;
-    else if (address == 0xFF1E) return gb->sound_controller->nr34;
-    else if (address == 0xFF1F) return UNMAPPED_ALL_ONES;
-    else if (address == 0xFF20) return sound_controller_read_nr41(gb);
-    else if (address == 0xFF21) return gb->sound_controller->nr42;
-    else if (address == 0xFF22) return gb->sound_controller->nr43;
-    else if (address == 0xFF23) return sound_controller_read_nr44(gb);
-    else if (address == 0xFF24) return gb->sound_controller->nr50;
-    else if (address == 0xFF25) return gb->sound_controller->nr51;
-    else if (address == 0xFF26) return sound_controller_read_nr52(gb);
-    else if (address == 0xFF27) return UNMAPPED_ALL_ONES;
-    else if (address == 0xFF28) return UNMAPPED_ALL_ONES;
-    else if (address == 0xFF29) return UNMAPPED_ALL_ONES;
-    else if (address == 0xFF40) return ppu_read_lcdc(gb);
-    else if (address == 0xFF41) return ppu_read_stat(gb);
-    else if (address == 0xFF42) return gb->ppu->scy;
-    else if (address == 0xFF43) return gb->ppu->scx;
-    else if (address == 0xFF44) return gb->ppu->ly;
-    else if (address == 0xFF45) return gb->ppu->lyc;
-    else if (address == 0xFF46) return gb->dma->dma;
-    else if (address == 0xFF47) return gb->ppu->bgp;
-    else if (address == 0xFF48) return gb->ppu->obp0;
-    else if (address == 0xFF49) return gb->ppu->obp1;
-    else if (address == 0xFF4A) return gb->ppu->wy;
-    else if (address == 0xFF4B) return gb->ppu->wx;
-    else if (address == 0xFF4C) return UNMAPPED_ALL_ONES;
-    else if (address == 0xFF4D) return UNMAPPED_ALL_ONES;
-    else if (address == 0xFF4E) return UNMAPPED_ALL_ONES;
-    else if (address == 0xFF4F) return UNMAPPED_ALL_ONES;
-    else if (address == 0xFF50) return gb->boot | 0b11111110; 
-    else if (address >= 0xFF51 && address <= 0xFF7F) return UNMAPPED_ALL_ONES;
-    else if (address >= 0xFF80 && address <= 0xFFFE) return gb->processor->hram[address - 0xFF80];
-    else if (address == 0xFFFF) return interrupt_controller_get_enables(gb);
-    else TRTLE_LOG_ERR("Attempted to read an unsupported address %X\n", address);
+static uint8_t gameboy_read_rom(GameBoy * const gb, uint16_t address) {
+    if (address <= 0x00FF && !gb->boot) return dmg_boot[address];
+    return dma_read_external_rom(gb, address);
+}
+
+// A bank register write only moves the cartridge pages
+static void gameboy_write_rom(GameBoy * const gb, uint16_t address, uint8_t value) {
+    cartridge_write_rom(gb, address, value);
+    gb->processor->block = NULL;
+    gameboy_map_cartridge(gb);
+}
+
+static uint8_t gameboy_read_vram(GameBoy * const gb, uint16_t address) {
+    return dma_read_vram(gb, address - 0x8000);
+}
+
+static void gameboy_write_vram(GameBoy * const gb, uint16_t address, uint8_t value) {
+    ppu_write_vram(gb, address - 0x8000, value);
+}
+
+static uint8_t gameboy_read_external_ram(GameBoy * const gb, uint16_t address) {
+    return dma_read_external_ram(gb, address);
+}
+
+static void gameboy_write_external_ram(GameBoy * const gb, uint16_t address, uint8_t value) {
+    cartridge_write_ram(gb, address, value);
+}
+
+static uint8_t gameboy_read_ram(GameBoy * const gb, uint16_t address) {
+    return gb->processor->ram[address & 0x1FFF];
+}
+
+// Only reached for WRAM pages that hold decoded code
+static void gameboy_write_ram(GameBoy * const gb, uint16_t address, uint8_t value) {
+    gb->processor->ram[address & 0x1FFF] = value;
+    processor_invalidate_code(gb, address);
+}
+
+static uint8_t gameboy_read_oam(GameBoy * const gb, uint16_t address) {
+    if (address <= 0xFE9F) return dma_read_oam(gb, address - 0xFE00);
+    return 0x00;
+}
+
+static void gameboy_write_oam(GameBoy * const gb, uint16_t address, uint8_t value) {
+    if (address <= 0xFE9F) ppu_write_oam(gb, address - 0xFE00, value);
+    else TRTLE_LOG_ERR("Attempted to write to an unsupported address %X\n", address);
+}
+
+static uint8_t gameboy_read_io(GameBoy * const gb, uint16_t address) {
+    uint8_t const * byte = gb->io_read_bytes[address & 0xFF];
+    if (byte != NULL) return *byte | gb->io_masks[address & 0xFF];
+    return gb->io_read_handlers[address & 0xFF](gb, address);
+}
+
+static void gameboy_write_io(GameBoy * const gb, uint16_t address, uint8_t value) {
+    uint8_t * byte = gb->io_write_bytes[address & 0xFF];
+    if (byte != NULL) *byte = value;
+    else gb->io_write_handlers[address & 0xFF](gb, address, value);
+}
+
+// Registers whose reads or writes have side effects
+static uint8_t gameboy_read_p1(GameBoy * const gb, uint16_t address) {
+    return joypad_read_p1(gb);
+}
+
+static void gameboy_write_p1(GameBoy * const gb, uint16_t address, uint8_t value) {
+    joypad_write_p1(gb, value);
+}
+
+static uint8_t gameboy_read_div(GameBoy * const gb, uint16_t address) {
+    return timer_read_div(gb);
+}
+
+static void gameboy_write_div(GameBoy * const gb, uint16_t address, uint8_t value) {
+    timer_write_div(gb);
+}
+
+static uint8_t gameboy_read_tima(GameBoy * const gb, uint16_t address) {
+    return timer_read_tima(gb);
+}
+
+static void gameboy_write_tima(GameBoy * const gb, uint16_t address, uint8_t value) {
+    timer_write_tima(gb, value);
+}
+
+static void gameboy_write_tma(GameBoy * const gb, uint16_t address, uint8_t value) {
+    timer_write_tma(gb, value);
+}
+
+static void gameboy_write_tac(GameBoy * const gb, uint16_t address, uint8_t value) {
+    timer_write_tac(gb, value);
+}
+
+static void gameboy_write_if(GameBoy * const gb, uint16_t address, uint8_t value) {
+    interrupt_controller_set_flags(gb, value);
+}
+
+static void gameboy_write_lcdc(GameBoy * const gb, uint16_t address, uint8_t value) {
+    ppu_write_lcdc(gb, value);
+}
+
+static uint8_t gameboy_read_stat(GameBoy * const gb, uint16_t address) {
+    return ppu_read_stat(gb);
+}
+
+static void gameboy_write_stat(GameBoy * const gb, uint16_t address, uint8_t value) {
+    ppu_write_stat(gb, value);
+}
+
+static void gameboy_write_dma(GameBoy * const gb, uint16_t address, uint8_t value) {
+    dma_write_dma(gb, value);
+}
+
+static void gameboy_write_boot(GameBoy * const gb, uint16_t address, uint8_t value) {
+    if (gb->boot == 0) gb->boot = value == 0 ? 0 : 1;
+    gameboy_remap(gb);
+}
+
+static void gameboy_write_hram(GameBoy * const gb, uint16_t address, uint8_t value) {
+    gb->processor->hram[address - 0xFF80] = value;
+    processor_invalidate_code(gb, address);
+}
+
+static void gameboy_write_ie(GameBoy * const gb, uint16_t address, uint8_t value) {
+    interrupt_controller_set_enables(gb, value);
+}
+
+static uint8_t gameboy_read_unsupported(GameBoy * const gb, uint16_t address) {
+    TRTLE_LOG_ERR("Attempted to read an unsupported address %X\n", address);
     return 0xFF;
 }
 
+static void gameboy_write_unsupported(GameBoy * const gb, uint16_t address, uint8_t value) {
+    TRTLE_LOG_ERR("Attempted to write to an unsupported address %X\n", address);
+}
+
+// A register backed by a plain byte, read bits set in mask always read back as ones. Either byte
+// can be null to send that direction through the handler instead.
+static void gameboy_map_io(GameBoy * const gb, uint8_t reg, uint8_t * read, uint8_t * write, uint8_t mask) {
+    gb->io_read_bytes[reg] = read;
+    gb->io_write_bytes[reg] = write;
+    gb->io_masks[reg] = mask;
+}
+
+static void gameboy_map_io_handlers(GameBoy * const gb) {
+    for (size_t reg = 0x00; reg <= 0xFF; reg++) {
+        gameboy_map_io(gb, reg, NULL, NULL, 0x00);
+        gb->io_read_handlers[reg] = gameboy_read_unsupported;
+        gb->io_write_handlers[reg] = gameboy_write_unsupported;
+    }
+
+    // Unmapped registers read as all ones and ignore writes
+    uint8_t const unmapped[] = { 0x03, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x15, 0x1F, 0x27, 0x28, 0x29, 0x4C, 0x4D, 0x4E, 0x4F };
+    for (size_t i = 0; i < sizeof(unmapped); i++) gameboy_map_io(gb, unmapped[i], &gb->io_unmapped, &gb->io_unmapped, UNMAPPED_ALL_ONES);
+    for (size_t reg = 0x51; reg <= 0x7F; reg++) gameboy_map_io(gb, reg, &gb->io_unmapped, &gb->io_unmapped, UNMAPPED_ALL_ONES);
+
+    gb->io_read_handlers[0x00] = gameboy_read_p1;
+    gb->io_write_handlers[0x00] = gameboy_write_p1;
+    gameboy_map_io(gb, 0x01, &gb->serial->sb, &gb->serial->sb, 0x00);
+    gameboy_map_io(gb, 0x02, &gb->serial->sc, &gb->serial->sc, SERIAL_SC_MASK);
+
+    gb->io_read_handlers[0x04] = gameboy_read_div;
+    gb->io_write_handlers[0x04] = gameboy_write_div;
+    gb->io_read_handlers[0x05] = gameboy_read_tima;
+    gb->io_write_handlers[0x05] = gameboy_write_tima;
+    gameboy_map_io(gb, 0x06, &gb->timer->tma, NULL, 0x00);
+    gb->io_write_handlers[0x06] = gameboy_write_tma;
+    gameboy_map_io(gb, 0x07, &gb->timer->tac, NULL, TIMER_TAC_MASK);
+    gb->io_write_handlers[0x07] = gameboy_write_tac;
+    gameboy_map_io(gb, 0x0F, &gb->interrupt_controller->flags, NULL, INTERRUPT_MASK);
+    gb->io_write_handlers[0x0F] = gameboy_write_if;
+
+    SoundController * const sc = gb->sound_controller;
+    gameboy_map_io(gb, 0x10, &sc->nr10, &sc->nr10, SOUND_CONTROLLER_NR10_MASK);
+    gameboy_map_io(gb, 0x11, &sc->nr11, &sc->nr11, 0x00);
+    gameboy_map_io(gb, 0x12, &sc->nr12, &sc->nr12, 0x00);
+    gameboy_map_io(gb, 0x13, &sc->nr13, &sc->nr13, 0x00);
+    gameboy_map_io(gb, 0x14, &sc->nr14, &sc->nr14, 0x00);
+    gameboy_map_io(gb, 0x16, &sc->nr21, &sc->nr21, 0x00);
+    gameboy_map_io(gb, 0x17, &sc->nr22, &sc->nr22, 0x00);
+    gameboy_map_io(gb, 0x18, &sc->nr23, &sc->nr23, 0x00);
+    gameboy_map_io(gb, 0x19, &sc->nr24, &sc->nr24, 0x00);
+    gameboy_map_io(gb, 0x1A, &sc->nr30, &sc->nr30, SOUND_CONTROLLER_NR30_MASK);
+    gameboy_map_io(gb, 0x1B, &sc->nr31, &sc->nr31, 0x00);
+    gameboy_map_io(gb, 0x1C, &sc->nr32, &sc->nr32, SOUND_CONTROLLER_NR32_MASK);
+    gameboy_map_io(gb, 0x1D, &sc->nr33, &sc->nr33, 0x00);
+    gameboy_map_io(gb, 0x1E, &sc->nr34, &sc->nr34, 0x00);
+    gameboy_map_io(gb, 0x20, &sc->nr41, &sc->nr41, SOUND_CONTROLLER_NR41_MASK);
+    gameboy_map_io(gb, 0x21, &sc->nr42, &sc->nr42, 0x00);
+    gameboy_map_io(gb, 0x22, &sc->nr43, &sc->nr43, 0x00);
+    gameboy_map_io(gb, 0x23, &sc->nr44, &sc->nr44, SOUND_CONTROLLER_NR44_MASK);
+    gameboy_map_io(gb, 0x24, &sc->nr50, &sc->nr50, 0x00);
+    gameboy_map_io(gb, 0x25, &sc->nr51, &sc->nr51, 0x00);
+    gameboy_map_io(gb, 0x26, &sc->nr52, &sc->nr52, SOUND_CONTROLLER_NR52_MASK);
+
+    PPU * const ppu = gb->ppu;
+    gameboy_map_io(gb, 0x40, &ppu->lcdc, NULL, 0x00);
+    gb->io_write_handlers[0x40] = gameboy_write_lcdc;
+    gb->io_read_handlers[0x41] = gameboy_read_stat;
+    gb->io_write_handlers[0x41] = gameboy_write_stat;
+    gameboy_map_io(gb, 0x42, &ppu->scy, &ppu->scy, 0x00);
+    gameboy_map_io(gb, 0x43, &ppu->scx, &ppu->scx, 0x00);
+    gameboy_map_io(gb, 0x44, &ppu->ly, &ppu->ly, 0x00);
+    gameboy_map_io(gb, 0x45, &ppu->lyc, &ppu->lyc, 0x00);
+    gameboy_map_io(gb, 0x46, &gb->dma->dma, NULL, 0x00);
+    gb->io_write_handlers[0x46] = gameboy_write_dma;
+    gameboy_map_io(gb, 0x47, &ppu->bgp, &ppu->bgp, 0x00);
+    gameboy_map_io(gb, 0x48, &ppu->obp0, &ppu->obp0, 0x00);
+    gameboy_map_io(gb, 0x49, &ppu->obp1, &ppu->obp1, 0x00);
+    gameboy_map_io(gb, 0x4A, &ppu->wy, &ppu->wy, 0x00);
+    gameboy_map_io(gb, 0x4B, &ppu->wx, &ppu->wx, 0x00);
+
+    gameboy_map_io(gb, 0x50, &gb->boot, NULL, 0b11111110);
+    gb->io_write_handlers[0x50] = gameboy_write_boot;
+
+    // HRAM is written directly too, apart from bytes holding code, see gameboy_remap
+    for (size_t reg = 0x80; reg <= 0xFE; reg++) {
+        gameboy_map_io(gb, reg, &gb->processor->hram[reg - 0x80], &gb->processor->hram[reg - 0x80], 0x00);
+        gb->io_write_handlers[reg] = gameboy_write_hram;
+    }
+    gameboy_map_io(gb, 0xFF, &gb->interrupt_controller->enables, NULL, 0x00);
+    gb->io_write_handlers[0xFF] = gameboy_write_ie;
+}
+
+static void gameboy_map_handlers(GameBoy * const gb) {
+    for (size_t page = 0x00; page <= 0x7F; page++) {
+        gb->read_handlers[page] = gameboy_read_rom;
+        gb->write_handlers[page] = gameboy_write_rom;
+    }
+    for (size_t page = 0x80; page <= 0x9F; page++) {
+        gb->read_handlers[page] = gameboy_read_vram;
+        gb->write_handlers[page] = gameboy_write_vram;
+    }
+    for (size_t page = 0xA0; page <= 0xBF; page++) {
+        gb->read_handlers[page] = gameboy_read_external_ram;
+        gb->write_handlers[page] = gameboy_write_external_ram;
+    }
+    for (size_t page = 0xC0; page <= 0xFD; page++) {
+        gb->read_handlers[page] = gameboy_read_ram;
+        gb->write_handlers[page] = gameboy_write_ram;
+    }
+    gb->read_handlers[0xFE] = gameboy_read_oam;
+    gb->write_handlers[0xFE] = gameboy_write_oam;
+    gb->read_handlers[0xFF] = gameboy_read_io;
+    gb->write_handlers[0xFF] = gameboy_write_io;
+    gameboy_map_io_handlers(gb);
+}
+
+static void gameboy_map_cartridge(GameBoy * const gb) {
+    // An active DMA hijacks the external bus, so those reads have to go through the handlers
+    bool conflict = gb->dma->active;
+
+    if (!conflict) cartridge_map_rom(gb, gb->read_pages);
+    for (size_t page = 0x00; page <= 0x7F; page++) {
+        if (conflict) gb->read_pages[page] = NULL;
+        gb->write_pages[page] = NULL;
+    }
+    if (!gb->boot) gb->read_pages[0x00] = dmg_boot;
+
+    for (size_t page = 0xA0; page <= 0xBF; page++) {
+        uint8_t * ram = cartridge_get_ram_page(gb, page << 8);
+        gb->read_pages[page] = conflict ? NULL : ram;
+        gb->write_pages[page] = ram;
+    }
+}
+
+void gameboy_remap(GameBoy * const gb) {
+    bool conflict = gb->dma->active;
+
+    gb->processor->block = NULL;
+
+    gameboy_map_cartridge(gb);
+
+    for (size_t page = 0x80; page <= 0x9F; page++) {
+        gb->read_pages[page] = conflict ? NULL : &gb->ppu->vram[(page - 0x80) * GAMEBOY_PAGE_SIZE];
+        gb->write_pages[page] = NULL;
+    }
+    for (size_t page = 0xC0; page <= 0xDF; page++) {
+        bool code = gb->processor->ram_code_pages[page - 0xC0];
+        gb->read_pages[page] = &gb->processor->ram[(page - 0xC0) * GAMEBOY_PAGE_SIZE];
+        gb->write_pages[page] = code ? NULL : &gb->processor->ram[(page - 0xC0) * GAMEBOY_PAGE_SIZE];
+    }
+    for (size_t page = 0xE0; page <= 0xFD; page++) { // ECHO
+        bool code = gb->processor->ram_code_pages[page - 0xE0];
+        gb->read_pages[page] = &gb->processor->ram[(page - 0xE0) * GAMEBOY_PAGE_SIZE];
+        gb->write_pages[page] = code ? NULL : &gb->processor->ram[(page - 0xE0) * GAMEBOY_PAGE_SIZE];
+    }
+    gb->read_pages[0xFE] = NULL;
+    gb->write_pages[0xFE] = NULL;
+    gb->read_pages[0xFF] = NULL;
+    gb->write_pages[0xFF] = NULL;
+    for (size_t reg = 0x80; reg <= 0xFE; reg++) {
+        bool code = gb->processor->code_map[sizeof(gb->processor->ram) + reg - 0x80];
+        gb->io_write_bytes[reg] = code ? NULL : &gb->processor->hram[reg - 0x80];
+    }
+}
+
+uint8_t gameboy_read(GameBoy * const gb, uint16_t address) {
+    uint8_t const * page = gb->read_pages[address >> 8];
+    if (page != NULL) return page[address & 0xFF];
+    return gb->read_handlers[address >> 8](gb, address);
+}
+
 void gameboy_write(GameBoy * const gb, uint16_t address, uint8_t value) {
-    if      (address <= 0x7FFF) cartridge_write_rom(gb, address, value);
-    else if (address <= 0x9FFF) ppu_write_vram(gb, address - 0x8000, value);
-    else if (address <= 0xBFFF) cartridge_write_ram(gb, address, value - 0xA000);
-    else if (address <= 0xDFFF) gb->processor->ram[address - 0xC000] = value;
-    else if (address <= 0xFDFF) gb->processor->ram[address - 0xE000] = value;
-    else if (address <= 0xFE9F) ppu_write_oam(gb, address - 0xFE00, value);
-    else if (address == 0xFF00) joypad_write_p1(gb, value);
-    else if (address == 0xFF01) gb->serial->sb = value;
-    else if (address == 0xFF02) gb->serial->sc = value;
-    else if (address == 0xFF03) return; // Unmapped
-    else if (address == 0xFF04) timer_write_div(gb);
-    else if (address == 0xFF05) timer_write_tima(gb, value);
-    else if (address == 0xFF06) timer_write_tma(gb, value);
-    else if (address == 0xFF07) timer_write_tac(gb, value);
-    else if (address == 0xFF08) return; // Unmapped
-    else if (address == 0xFF09) return; // Unmapped
-    else if (address == 0xFF0A) return; // Unmapped
-    else if (address == 0xFF0B) return; // Unmapped
-    else if (address == 0xFF0C) return; // Unmapped
-    else if (address == 0xFF0D) return; // Unmapped
-    else if (address == 0xFF0E) return; // Unmapped
-    else if (address == 0xFF0F) interrupt_controller_set_flags(gb, value);
-    else if (address == 0xFF10) gb->sound_controller->nr10 = value;
-    else if (address == 0xFF11) gb->sound_controller->nr11 = value;
-    else if (address == 0xFF12) gb->sound_controller->nr12 = value;
-    else if (address == 0xFF13) gb->sound_controller->nr13 = value;
-    else if (address == 0xFF14) gb->sound_controller->nr14 = value;
-    else if (address == 0xFF15) return; // Unmapped
-    else if (address == 0xFF16) gb->sound_controller->nr21 = value;
-    else if (address == 0xFF17) gb->sound_controller->nr22 = value;
-    else if (address == 0xFF18) gb->sound_controller->nr23 = value;
-    else if (address == 0xFF19) gb->sound_controller->nr24 = value;
-    else if (address == 0xFF1A) gb->sound_controller->nr30 = value;
-    else if (address == 0xFF1B) gb->sound_controller->nr31 = value;
-    else if (address == 0xFF1C) gb->sound_controller->nr32 = value;
-    else if (address == 0xFF1D) gb->sound_controller->nr33 = value;
-    else if (address == 0xFF1E) gb->sound_controller->nr34 = value;
-    else if (address == 0xFF1F) return; // Unmapped
-    else if (address == 0xFF20) gb->sound_controller->nr41 = value;
-    else if (address == 0xFF21) gb->sound_controller->nr42 = value;
-    else if (address == 0xFF22) gb->sound_controller->nr43 = value;
-    else if (address == 0xFF23) gb->sound_controller->nr44 = value;
-    else if (address == 0xFF24) gb->sound_controller->nr50 = value;
-    else if (address == 0xFF25) gb->sound_controller->nr51 = value;
-    else if (address == 0xFF26) gb->sound_controller->nr52 = value;
-    else if (address == 0xFF27) return; // Unmapped
-    else if (address == 0xFF28) return; // Unmapped
-    else if (address == 0xFF29) return; // Unmapped
-    else if (address == 0xFF40) ppu_write_lcdc(gb, value);
-    else if (address == 0xFF41) ppu_write_stat(gb, value);
-    else if (address == 0xFF42) gb->ppu->scy = value;
-    else if (address == 0xFF43) gb->ppu->scx = value;
-    else if (address == 0xFF44) gb->ppu->ly = value;
-    else if (address == 0xFF45) gb->ppu->lyc = value;
-    else if (address == 0xFF46) dma_write_dma(gb, value);
-    else if (address == 0xFF47) gb->ppu->bgp = value;
-    else if (address == 0xFF48) gb->ppu->obp0 = value;
-    else if (address == 0xFF49) gb->ppu->obp1 = value;
-    else if (address == 0xFF4A) gb->ppu->wy = value;
-    else if (address == 0xFF4B) gb->ppu->wx = value;
-    else if (address >= 0xFF4C && address <= 0xFF4F) return; // Unmapped
-    else if (address == 0xFF50) { if (gb->boot == 0) gb->boot = value == 0 ? 0 : 1; }
-    else if (address >= 0xFF51 && address <= 0xFF7F) return; // Unmapped
-    else if (address >= 0xFF80 && address <= 0xFFFE) gb->processor->hram[address - 0xFF80] = value;
-    else if (address == 0xFFFF) interrupt_controller_set_enables(gb, value);
-    else TRTLE_LOG_ERR("Attempted to write to an unsupported address %X\n", address);
+    uint8_t * page = gb->write_pages[address >> 8];
+    if (page != NULL) page[address & 0xFF] = value;
+    else gb->write_handlers[address >> 8](gb, address, value);
 }
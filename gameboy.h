@@ -2,6 +2,7 @@
 #define TRTLE_GAMEBOY_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #define GAMEBOY_TILESET_WIDTH  (128)
@@ -11,22 +12,41 @@
 #define GAMEBOY_DISPLAY_WIDTH  (160)
 #define GAMEBOY_DISPLAY_HEIGHT (144)
 #define GAMEBOY_DISPLAY_PIXEL_COUNT (GAMEBOY_DISPLAY_WIDTH * GAMEBOY_DISPLAY_HEIGHT)
+#define GAMEBOY_FRAME_CYCLES (17556) // M-cycles from one VBlank to the next
 
 #define GAMEBOY_BOOTROM_ADDRESS     (0x0000)
 #define GAMEBOY_ROM_ADDRESS         (0x0000)
 #define GAMEBOY_VRAM_ADDRESS        (0x8000)
 #define GAMEBOY_OAM_ADDRESS         (0xFE00)
 
+#define GAMEBOY_PAGE_COUNT (256)
+#define GAMEBOY_PAGE_SIZE  (256)
+
+typedef struct Aot Aot;
 typedef struct Cartridge Cartridge;
+typedef struct GameBoy GameBoy;
 typedef struct DMA DMA;
 typedef struct InterruptController InterruptController;
+typedef struct Jit Jit;
 typedef struct Joypad Joypad;
 typedef struct PPU PPU;
 typedef struct Processor Processor;
+typedef struct Scheduler Scheduler;
 typedef struct Serial Serial;
 typedef struct SoundController SoundController;
 typedef struct Timer Timer;
 
+typedef uint8_t (*GameBoyReadHandler)(GameBoy * const gb, uint16_t address);
+typedef void (*GameBoyWriteHandler)(GameBoy * const gb, uint16_t address, uint8_t value);
+
+// The run loop has a variant for each of these, see gameboy_update_run_state
+typedef enum GameBoyRunState {
+    GAMEBOY_RUN_NORMAL = 0,
+    GAMEBOY_RUN_HALTED,
+    GAMEBOY_RUN_DMA,
+    GAMEBOY_RUN_LCD_OFF
+} GameBoyRunState;
+
 typedef struct GameBoyInput {
     bool a;
     bool b;
@@ -45,10 +65,31 @@ typedef struct GameBoy {
     Joypad * joypad;
     PPU * ppu;
     Processor * processor;
+    Scheduler * scheduler;
     Serial * serial;
     SoundController * sound_controller;
     Timer * timer;
+    Jit * jit; // Only set when the JIT is built in and enabled
+    Aot * aot; // Only set while a module built from the cartridge is loaded
     uint8_t boot;
+    bool instruction_timing; // See gameboy_set_instruction_timing
+    uint8_t run_state;
+
+    // Page table for the bus, a non-null page is read or written directly,
+    // otherwise the access falls through to the handler for that page
+    uint8_t const * read_pages[GAMEBOY_PAGE_COUNT];
+    uint8_t * write_pages[GAMEBOY_PAGE_COUNT];
+    GameBoyReadHandler read_handlers[GAMEBOY_PAGE_COUNT];
+    GameBoyWriteHandler write_handlers[GAMEBOY_PAGE_COUNT];
+
+    // The same for the FFxx registers, one entry each. A non-null byte is accessed directly, reads
+    // ORed with the register's mask of bits that read back as ones, otherwise the handler runs.
+    uint8_t * io_read_bytes[GAMEBOY_PAGE_SIZE];
+    uint8_t * io_write_bytes[GAMEBOY_PAGE_SIZE];
+    uint8_t io_masks[GAMEBOY_PAGE_SIZE];
+    uint8_t io_unmapped; // Stands in for registers that don't exist, writes land here and reads mask it away
+    GameBoyReadHandler io_read_handlers[GAMEBOY_PAGE_SIZE];
+    GameBoyWriteHandler io_write_handlers[GAMEBOY_PAGE_SIZE];
 } GameBoy;
 
 GameBoy * gameboy_create();
@@ -56,15 +97,23 @@ void gameboy_delete(GameBoy * gb);
 void gameboy_reset(GameBoy * gb);
 
 void gameboy_set_cartridge(GameBoy * const gb, Cartridge * const cartridge);
+bool gameboy_set_jit(GameBoy * const gb, bool enabled);
+bool gameboy_load_aot(GameBoy * const gb, char const * path);
+void gameboy_set_instruction_timing(GameBoy * const gb, bool enabled);
 
 void gameboy_update(GameBoy * const gb, GameBoyInput input);
 void gameboy_update_to_vblank(GameBoy * const gb, GameBoyInput input);
+void gameboy_update_to_clock(GameBoy * const gb, GameBoyInput input, uint64_t clock);
+uint64_t gameboy_run_cycles(GameBoy * const gb, GameBoyInput input, uint64_t cycles);
 
 size_t gameboy_get_background_data(GameBoy const * const gb, uint32_t * data, size_t length);
 size_t gameboy_get_display_data(GameBoy const * const gb, uint32_t * data, size_t length);
 size_t gameboy_get_tileset_data(GameBoy const * const gb, uint32_t * data, size_t length);
 
 void gameboy_cycle(GameBoy* const gb);
+void gameboy_update_run_state(GameBoy * const gb);
+
+void gameboy_remap(GameBoy * const gb);
 
 uint8_t gameboy_read(GameBoy* const gb, uint16_t address);
 void gameboy_write(GameBoy* const gb, uint16_t address, uint8_t value);
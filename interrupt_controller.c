@@ -2,13 +2,26 @@
 
 #include "gameboy.h"
 
-#define INTERRUPT_MASK (0b11100000)
-
 void interrupt_controller_initialize(InterruptController * const ic, bool skip_bootrom) {
     ic->enables = 0;
     ic->flags = skip_bootrom ? 1 : 0;
     ic->ime = 0;
     ic->cycles_until_ime = -1;
+    interrupt_controller_update(ic);
+}
+
+void interrupt_controller_update(InterruptController * const ic) {
+    ic->pending = (ic->ime ? ic->flags & ic->enables & 0x1F : 0) | (ic->cycles_until_ime != -1 ? INTERRUPT_PENDING_EI : 0);
+}
+
+void interrupt_controller_request(GameBoy * const gb, uint8_t interrupt) {
+    gb->interrupt_controller->flags |= interrupt;
+    interrupt_controller_update(gb->interrupt_controller);
+}
+
+void interrupt_controller_set_ime(GameBoy * const gb, bool ime) {
+    gb->interrupt_controller->ime = ime;
+    interrupt_controller_update(gb->interrupt_controller);
 }
 
 uint8_t interrupt_controller_get_enables(GameBoy const * const gb) {
@@ -17,6 +30,7 @@ uint8_t interrupt_controller_get_enables(GameBoy const * const gb) {
 
 void interrupt_controller_set_enables(GameBoy * const gb, uint8_t value) {
     gb->interrupt_controller->enables = value;
+    interrupt_controller_update(gb->interrupt_controller);
 }
 
 uint8_t interrupt_controller_get_flags(GameBoy const * const gb) {
@@ -25,4 +39,5 @@ uint8_t interrupt_controller_get_flags(GameBoy const * const gb) {
 
 void interrupt_controller_set_flags(GameBoy * const gb, uint8_t value) {
     gb->interrupt_controller->flags = value | INTERRUPT_MASK;
+    interrupt_controller_update(gb->interrupt_controller);
 }
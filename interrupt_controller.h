@@ -10,6 +10,10 @@
 #define SERIAL_INTERRUPT_BIT     (0b00001000)
 #define JOYPAD_INTERRUPT_BIT     (0b00010000)
 
+#define INTERRUPT_MASK           (0b11100000) // Unused IF bits, they read back as ones
+
+#define INTERRUPT_PENDING_EI     (0x100) // An EI is waiting to set IME
+
 typedef struct GameBoy GameBoy;
 
 typedef struct InterruptController {
@@ -17,10 +21,17 @@ typedef struct InterruptController {
     uint8_t flags;
     uint8_t ime;
     int8_t cycles_until_ime;
+    uint16_t pending; // Requested and enabled interrupts while IME is set, plus INTERRUPT_PENDING_EI
 } InterruptController;
 
 void interrupt_controller_initialize(InterruptController * const ic, bool skip_bootrom);
 
+// Anything changing flags, enables, ime or cycles_until_ime calls this after
+void interrupt_controller_update(InterruptController * const ic);
+
+void interrupt_controller_request(GameBoy * const gb, uint8_t interrupt);
+void interrupt_controller_set_ime(GameBoy * const gb, bool ime);
+
 uint8_t interrupt_controller_get_enables(GameBoy const * const gb);
 void interrupt_controller_set_enables(GameBoy * const gb, uint8_t value);
 
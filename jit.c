@@ -0,0 +1,583 @@
+#include "jit.h"
+
+#if defined(TRTLE_JIT) && defined(__x86_64__) && !defined(_WIN32)
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "gameboy.h"
+#include "logger.h"
+#include "processor.h"
+#include "scheduler.h"
+
+#define PROCESSOR_CARRY_BIT      (0b00010000)
+#define PROCESSOR_HALF_BIT       (0b00100000)
+#define PROCESSOR_NEGATIVE_BIT   (0b01000000)
+#define PROCESSOR_ZERO_BIT       (0b10000000)
+
+// Host registers, only the low byte or word of each is used
+typedef enum JitRegister {
+    JIT_EAX = 0,
+    JIT_ECX = 1,
+    JIT_EDX = 2,
+} JitRegister;
+
+// A guard that leaves native code before the op at index, once the ops before it are charged
+typedef struct JitExit {
+    size_t patch;
+    size_t index;
+    size_t cycles;
+} JitExit;
+
+typedef struct JitEmitter {
+    uint8_t * code;
+    size_t length;
+
+    ProcessorBlock const * block;
+    size_t start; // Index of the op the code was compiled from
+    size_t loop;  // Offset of the code right after the prologue
+    size_t total; // M-cycles of the longest pass through the ops
+    JitExit exits[2 * PROCESSOR_BLOCK_LENGTH];
+    size_t exit_count;
+} JitEmitter;
+
+// Maps the AH byte stored by LAHF (ZF, AF, CF) to Game Boy Z, H and C flags
+static uint8_t lahf_flags[256];
+
+// Operand register order used by the opcode encoding, 6 is (HL)
+static size_t const register_offsets[8] = {
+    offsetof(Processor, b), offsetof(Processor, c), offsetof(Processor, d), offsetof(Processor, e),
+    offsetof(Processor, h), offsetof(Processor, l), 0, offsetof(Processor, a),
+};
+
+static size_t const pair_offsets[4] = {
+    offsetof(Processor, bc), offsetof(Processor, de), offsetof(Processor, hl), offsetof(Processor, sp),
+};
+
+Jit * jit_create(void) {
+    uint8_t * buffer = mmap(NULL, JIT_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer == MAP_FAILED) {
+        TRTLE_LOG_WARN("Unable to map memory for the JIT\n");
+        return NULL;
+    }
+
+    for (size_t i = 0; i < 256; i++) {
+        lahf_flags[i] = 0;
+        if (i & 0x40) lahf_flags[i] |= PROCESSOR_ZERO_BIT;
+        if (i & 0x10) lahf_flags[i] |= PROCESSOR_HALF_BIT;
+        if (i & 0x01) lahf_flags[i] |= PROCESSOR_CARRY_BIT;
+    }
+
+    Jit * jit = calloc(1, sizeof(Jit));
+    jit->buffer = buffer;
+    jit->used = 0;
+    return jit;
+}
+
+void jit_delete(Jit * jit) {
+    if (jit != NULL) {
+        munmap(jit->buffer, JIT_BUFFER_SIZE);
+        free(jit);
+    }
+}
+
+static void emit(JitEmitter * const e, uint8_t byte) {
+    e->code[e->length++] = byte;
+}
+
+static void emit16(JitEmitter * const e, uint16_t value) {
+    emit(e, value);
+    emit(e, value >> 8);
+}
+
+static void emit32(JitEmitter * const e, uint32_t value) {
+    emit16(e, value);
+    emit16(e, value >> 16);
+}
+
+static void emit64(JitEmitter * const e, uint64_t value) {
+    emit32(e, value);
+    emit32(e, value >> 32);
+}
+
+// movzx reg, byte [rbx + offset]
+static void emit_load8(JitEmitter * const e, JitRegister reg, size_t offset) {
+    emit(e, 0x0F); emit(e, 0xB6); emit(e, 0x83 | reg << 3); emit32(e, offset);
+}
+
+// mov byte [rbx + offset], reg
+static void emit_store8(JitEmitter * const e, JitRegister reg, size_t offset) {
+    emit(e, 0x88); emit(e, 0x83 | reg << 3); emit32(e, offset);
+}
+
+// mov byte [rbx + offset], imm8
+static void emit_store8_imm(JitEmitter * const e, size_t offset, uint8_t value) {
+    emit(e, 0xC6); emit(e, 0x83); emit32(e, offset); emit(e, value);
+}
+
+// mov word [rbx + offset], imm16
+static void emit_store16_imm(JitEmitter * const e, size_t offset, uint16_t value) {
+    emit(e, 0x66); emit(e, 0xC7); emit(e, 0x83); emit32(e, offset); emit16(e, value);
+}
+
+// Converts the host flags left by the last operation into Game Boy flags in dl
+static void emit_flags(JitEmitter * const e) {
+    emit(e, 0x9F);                                                   // lahf
+    emit(e, 0x0F); emit(e, 0xB6); emit(e, 0xCC);                     // movzx ecx, ah
+    emit(e, 0x41); emit(e, 0x0F); emit(e, 0xB6); emit(e, 0x54); emit(e, 0x0D); emit(e, 0x00); // movzx edx, byte [r13 + rcx]
+}
+
+// and dl, imm8
+static void emit_and_dl(JitEmitter * const e, uint8_t value) {
+    emit(e, 0x80); emit(e, 0xE2); emit(e, value);
+}
+
+// or dl, imm8
+static void emit_or_dl(JitEmitter * const e, uint8_t value) {
+    emit(e, 0x80); emit(e, 0xCA); emit(e, value);
+}
+
+// Moves the Game Boy carry flag into the host carry flag
+static void emit_load_carry(JitEmitter * const e) {
+    emit_load8(e, JIT_EDX, offsetof(Processor, f));
+    emit(e, 0xC0); emit(e, 0xEA); emit(e, 0x05);                     // shr dl, 5
+}
+
+// Keeps the Game Boy carry flag across INC and DEC, which leave the host one alone
+static void emit_keep_carry(JitEmitter * const e) {
+    emit_and_dl(e, PROCESSOR_ZERO_BIT | PROCESSOR_HALF_BIT);
+    emit_load8(e, JIT_ECX, offsetof(Processor, f));
+    emit(e, 0x80); emit(e, 0xE1); emit(e, PROCESSOR_CARRY_BIT);      // and cl, imm8
+    emit(e, 0x08); emit(e, 0xCA);                                    // or dl, cl
+}
+
+// Calls the interpreter handler for an op with the decoded operands in place
+static void emit_call(JitEmitter * const e, ProcessorOp const * const op) {
+    emit_store16_imm(e, offsetof(Processor, pc), op->address + 1 + op->prefixed);
+    emit(e, 0x48); emit(e, 0xB8); emit64(e, (uintptr_t)(op->operands + op->prefixed)); // mov rax, imm64
+    emit(e, 0x48); emit(e, 0x89); emit(e, 0x83); emit32(e, offsetof(Processor, operands)); // mov [rbx + offset], rax
+    emit(e, 0x4C); emit(e, 0x89); emit(e, 0xE7);                     // mov rdi, r12
+    emit(e, 0x48); emit(e, 0xB8); emit64(e, (uintptr_t)op->execute); // mov rax, imm64
+    emit(e, 0xFF); emit(e, 0xD0);                                    // call rax
+#ifdef TRTLE_LAZY_FLAGS
+    // Translated ops read f directly, so the handler's flags are folded in before they run
+    emit(e, 0x4C); emit(e, 0x89); emit(e, 0xE7);                     // mov rdi, r12
+    emit(e, 0x48); emit(e, 0xB8); emit64(e, (uintptr_t)processor_sync_flags); // mov rax, imm64
+    emit(e, 0xFF); emit(e, 0xD0);                                    // call rax
+#endif
+}
+
+// Charges the cycles not already counted by handlers and returns the index of the op to resume at
+static void emit_exit(JitEmitter * const e, size_t cycles, size_t index) {
+    emit(e, 0x48); emit(e, 0xC7); emit(e, 0x83); emit32(e, offsetof(Processor, operands)); emit32(e, 0); // mov qword [rbx + offset], 0
+    if (cycles > 0) {
+        emit(e, 0x49); emit(e, 0x8B); emit(e, 0x8C); emit(e, 0x24); emit32(e, offsetof(GameBoy, scheduler)); // mov rcx, [r12 + offset]
+        emit(e, 0x48); emit(e, 0x81); emit(e, 0x81); emit32(e, offsetof(Scheduler, clock)); emit32(e, cycles); // add qword [rcx + offset], imm32
+    }
+    emit(e, 0xB8); emit32(e, index - e->start);                      // mov eax, imm32
+    emit(e, 0x41); emit(e, 0x5D);                                    // pop r13
+    emit(e, 0x41); emit(e, 0x5C);                                    // pop r12
+    emit(e, 0x5B);                                                   // pop rbx
+    emit(e, 0xC3);                                                   // ret
+}
+
+// Emits a conditional jump to a side exit, the stub itself is emitted after the code
+static void emit_side_exit(JitEmitter * const e, uint8_t condition, size_t index, size_t cycles) {
+    emit(e, 0x0F); emit(e, condition);                               // jcc rel32
+    e->exits[e->exit_count++] = (JitExit){ e->length, index, cycles };
+    emit32(e, 0);
+}
+
+static void emit_patch(JitEmitter * const e, size_t patch, size_t target) {
+    uint32_t distance = target - (patch + 4);
+    memcpy(&e->code[patch], &distance, sizeof(distance));
+}
+
+// Finds the host page for the address in eax, leaving it in rdx and the page offset in eax.
+// Pages without a direct pointer belong to handlers, those ops are left to the interpreter.
+static void emit_page(JitEmitter * const e, size_t table, bool writeback, size_t index, size_t cycles) {
+    emit(e, 0x89); emit(e, 0xC1);                                    // mov ecx, eax
+    emit(e, 0xC1); emit(e, 0xE9); emit(e, 0x08);                     // shr ecx, 8
+    emit(e, 0x49); emit(e, 0x8B); emit(e, 0x94); emit(e, 0xCC); emit32(e, table); // mov rdx, [r12 + rcx * 8 + offset]
+    emit(e, 0x48); emit(e, 0x85); emit(e, 0xD2);                     // test rdx, rdx
+    emit_side_exit(e, 0x84, index, cycles);
+    if (writeback) {
+        emit(e, 0x49); emit(e, 0x3B); emit(e, 0x94); emit(e, 0xCC); emit32(e, offsetof(GameBoy, write_pages)); // cmp rdx, [r12 + rcx * 8 + offset]
+        emit_side_exit(e, 0x85, index, cycles);
+    }
+    emit(e, 0x0F); emit(e, 0xB6); emit(e, 0xC0);                     // movzx eax, al
+}
+
+// movzx eax, word [rbx + offset]
+static void emit_address(JitEmitter * const e, size_t offset) {
+    emit(e, 0x0F); emit(e, 0xB7); emit(e, 0x83); emit32(e, offset);
+}
+
+// Reads the byte at the register pair into eax
+static void emit_read(JitEmitter * const e, size_t offset, size_t index, size_t cycles) {
+    emit_address(e, offset);
+    emit_page(e, offsetof(GameBoy, read_pages), false, index, cycles);
+    emit(e, 0x0F); emit(e, 0xB6); emit(e, 0x04); emit(e, 0x02);      // movzx eax, byte [rdx + rax]
+}
+
+// Emits an 8-bit ALU op on A with the operand in ecx
+static void emit_alu(JitEmitter * const e, uint8_t kind) {
+    // Game Boy order is ADD, ADC, SUB, SBC, AND, XOR, OR, CP, these are the "r/m8, r8" forms
+    static uint8_t const x86_opcodes[8] = { 0x00, 0x10, 0x28, 0x18, 0x20, 0x30, 0x08, 0x38 };
+
+    emit_load8(e, JIT_EAX, offsetof(Processor, a));
+    if (kind == 1 || kind == 3) emit_load_carry(e);
+    emit(e, x86_opcodes[kind]); emit(e, 0xC8);                       // op al, cl
+    if (kind != 7) emit_store8(e, JIT_EAX, offsetof(Processor, a));
+
+    emit_flags(e);
+    switch (kind) {
+        case 2: case 3: case 7: emit_or_dl(e, PROCESSOR_NEGATIVE_BIT); break;
+        case 4: emit_and_dl(e, PROCESSOR_ZERO_BIT); emit_or_dl(e, PROCESSOR_HALF_BIT); break;
+        case 5: case 6: emit_and_dl(e, PROCESSOR_ZERO_BIT); break;
+    }
+    emit_store8(e, JIT_EDX, offsetof(Processor, f));
+}
+
+// Emits BIT for the value in al
+static void emit_bit(JitEmitter * const e, uint8_t bit) {
+    emit_load8(e, JIT_EDX, offsetof(Processor, f));
+    emit_and_dl(e, PROCESSOR_CARRY_BIT);
+    emit_or_dl(e, PROCESSOR_HALF_BIT);
+    emit(e, 0xA8); emit(e, 1 << bit);                                // test al, imm8
+    emit(e, 0x75); emit(e, 0x03);                                    // jnz +3
+    emit_or_dl(e, PROCESSOR_ZERO_BIT);
+    emit_store8(e, JIT_EDX, offsetof(Processor, f));
+}
+
+// Total M-cycles of an op the JIT can run, zero when it has to be interpreted
+static size_t jit_get_cycles(ProcessorOp const * const op) {
+    uint8_t opcode = op->opcode;
+    uint8_t x = (opcode >> 3) & 7;
+    uint8_t y = opcode & 7;
+
+    if (opcode == 0x00) return 1;
+    if ((opcode & 0xCF) == 0x01) return 3;
+    if ((opcode & 0xC7) == 0x02) return 2;
+    if ((opcode & 0xCF) == 0x03 || (opcode & 0xCF) == 0x0B || (opcode & 0xCF) == 0x09) return 2;
+    if (opcode < 0x40 && (y == 4 || y == 5)) return x != 6 ? 1 : 3;
+    if (opcode < 0x40 && y == 6) return x != 6 ? 2 : 3;
+    if (opcode < 0x40 && y == 7) return 1;
+    if (opcode == 0x76) return 0;
+    if (opcode >= 0x40 && opcode < 0x80) return x != 6 && y != 6 ? 1 : 2;
+    if (opcode >= 0x80 && opcode < 0xC0) return y != 6 ? 1 : 2;
+    if ((opcode & 0xC7) == 0xC6) return 2;
+    if (opcode == 0xCB) {
+        if ((op->operands[0] & 7) != 6) return 2;
+        return (op->operands[0] & 0xC0) == 0x40 ? 3 : 0;
+    }
+
+    switch (opcode) {
+        case 0x18: case 0x20: case 0x28: case 0x30: case 0x38: return 3;
+        case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA: return 4;
+        case 0xE8: return 4;
+        case 0xE9: return 1;
+        case 0xEA: return 4;
+        case 0xF8: return 3;
+        case 0xF9: return 2;
+        case 0xFA: return 4;
+    }
+    return 0;
+}
+
+static bool jit_is_branch(uint8_t opcode) {
+    switch (opcode) {
+        case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:
+        case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA:
+        case 0xE9:
+            return true;
+    }
+    return false;
+}
+
+// Emits the op at index, returning the cycles the native code has to charge for it
+static size_t jit_emit_op(JitEmitter * const e, size_t index, size_t cycles) {
+    ProcessorOp const * const op = &e->block->ops[index];
+    uint8_t opcode = op->opcode;
+    uint8_t x = (opcode >> 3) & 7;
+    uint8_t y = opcode & 7;
+
+    if (opcode == 0x00) return 1;
+    if ((opcode & 0xCF) == 0x01) {
+        emit_store16_imm(e, pair_offsets[opcode >> 4], op->operands[0] | op->operands[1] << 8);
+        return 3;
+    }
+    if ((opcode & 0xC7) == 0x02) {
+        // LD (BC), A through LD A, (HL-), the last two step HL afterwards
+        size_t pair = pair_offsets[opcode < 0x20 ? opcode >> 4 : 2];
+        if (opcode & 0x08) {
+            emit_read(e, pair, index, cycles);
+            emit_store8(e, JIT_EAX, offsetof(Processor, a));
+        }
+        else {
+            emit_address(e, pair);
+            emit_page(e, offsetof(GameBoy, write_pages), false, index, cycles);
+            emit_load8(e, JIT_ECX, offsetof(Processor, a));
+            emit(e, 0x88); emit(e, 0x0C); emit(e, 0x02);             // mov [rdx + rax], cl
+        }
+        if (opcode >= 0x20) {
+            emit(e, 0x66); emit(e, 0xFF); emit(e, opcode >= 0x30 ? 0x8B : 0x83); emit32(e, offsetof(Processor, hl)); // inc/dec word [rbx + offset]
+        }
+        return 2;
+    }
+    if ((opcode & 0xCF) == 0x03 || (opcode & 0xCF) == 0x0B) {
+        emit(e, 0x66); emit(e, 0xFF); emit(e, (opcode & 0x08) ? 0x8B : 0x83); emit32(e, pair_offsets[opcode >> 4]); // inc/dec word [rbx + offset]
+        return 2;
+    }
+    if (opcode < 0x40 && (y == 4 || y == 5)) {
+        if (x == 6) {
+            emit_address(e, offsetof(Processor, hl));
+            emit_page(e, offsetof(GameBoy, read_pages), true, index, cycles);
+            emit(e, 0x0F); emit(e, 0xB6); emit(e, 0x0C); emit(e, 0x02); // movzx ecx, byte [rdx + rax]
+            emit(e, 0xFE); emit(e, y == 4 ? 0xC1 : 0xC9);            // inc/dec cl
+            emit(e, 0x88); emit(e, 0x0C); emit(e, 0x02);             // mov [rdx + rax], cl
+        }
+        else {
+            emit_load8(e, JIT_EAX, register_offsets[x]);
+            emit(e, 0xFE); emit(e, y == 4 ? 0xC0 : 0xC8);            // inc/dec al
+            emit_store8(e, JIT_EAX, register_offsets[x]);
+        }
+        emit_flags(e);
+        emit_keep_carry(e);
+        if (y == 5) emit_or_dl(e, PROCESSOR_NEGATIVE_BIT);
+        emit_store8(e, JIT_EDX, offsetof(Processor, f));
+        return x == 6 ? 3 : 1;
+    }
+    if (opcode < 0x40 && y == 6) {
+        if (x == 6) {
+            emit_address(e, offsetof(Processor, hl));
+            emit_page(e, offsetof(GameBoy, write_pages), false, index, cycles);
+            emit(e, 0xC6); emit(e, 0x04); emit(e, 0x02); emit(e, op->operands[0]); // mov byte [rdx + rax], imm8
+            return 3;
+        }
+        emit_store8_imm(e, register_offsets[x], op->operands[0]);
+        return 2;
+    }
+    if (opcode == 0x2F) {
+        emit(e, 0x80); emit(e, 0xB3); emit32(e, offsetof(Processor, a)); emit(e, 0xFF); // xor byte [rbx + offset], imm8
+        emit(e, 0x80); emit(e, 0x8B); emit32(e, offsetof(Processor, f)); emit(e, PROCESSOR_NEGATIVE_BIT | PROCESSOR_HALF_BIT); // or byte [rbx + offset], imm8
+        return 1;
+    }
+    if (opcode == 0x37 || opcode == 0x3F) {
+        emit_load8(e, JIT_EDX, offsetof(Processor, f));
+        if (opcode == 0x37) {
+            emit_and_dl(e, PROCESSOR_ZERO_BIT);
+            emit_or_dl(e, PROCESSOR_CARRY_BIT);
+        }
+        else {
+            emit(e, 0x80); emit(e, 0xF2); emit(e, PROCESSOR_CARRY_BIT); // xor dl, imm8
+            emit_and_dl(e, PROCESSOR_ZERO_BIT | PROCESSOR_CARRY_BIT);
+        }
+        emit_store8(e, JIT_EDX, offsetof(Processor, f));
+        return 1;
+    }
+    if (opcode >= 0x40 && opcode < 0x80) {
+        if (y == 6) {
+            emit_read(e, offsetof(Processor, hl), index, cycles);
+            emit_store8(e, JIT_EAX, register_offsets[x]);
+            return 2;
+        }
+        if (x == 6) {
+            emit_address(e, offsetof(Processor, hl));
+            emit_page(e, offsetof(GameBoy, write_pages), false, index, cycles);
+            emit_load8(e, JIT_ECX, register_offsets[y]);
+            emit(e, 0x88); emit(e, 0x0C); emit(e, 0x02);             // mov [rdx + rax], cl
+            return 2;
+        }
+        if (x != y) {
+            emit_load8(e, JIT_EAX, register_offsets[y]);
+            emit_store8(e, JIT_EAX, register_offsets[x]);
+        }
+        return 1;
+    }
+    // SBC A,A reads A back after writing it, which the handler models
+    if (opcode >= 0x80 && opcode < 0xC0 && opcode != 0x9F) {
+        if (y == 6) {
+            emit_read(e, offsetof(Processor, hl), index, cycles);
+            emit(e, 0x89); emit(e, 0xC1);                            // mov ecx, eax
+        }
+        else {
+            emit_load8(e, JIT_ECX, register_offsets[y]);
+        }
+        emit_alu(e, x);
+        return y == 6 ? 2 : 1;
+    }
+    if ((opcode & 0xC7) == 0xC6) {
+        emit(e, 0xB9); emit32(e, op->operands[0]);                   // mov ecx, imm32
+        emit_alu(e, x);
+        return 2;
+    }
+    if (opcode == 0xCB && (op->operands[0] & 0xC0) == 0x40) {
+        uint8_t bit = (op->operands[0] >> 3) & 7;
+        if ((op->operands[0] & 7) == 6) {
+            emit_read(e, offsetof(Processor, hl), index, cycles);
+            emit_bit(e, bit);
+            return 3;
+        }
+        emit_load8(e, JIT_EAX, register_offsets[op->operands[0] & 7]);
+        emit_bit(e, bit);
+        return 2;
+    }
+    if (opcode == 0xEA || opcode == 0xFA) {
+        emit(e, 0xB8); emit32(e, op->operands[0] | op->operands[1] << 8); // mov eax, imm32
+        if (opcode == 0xFA) {
+            emit_page(e, offsetof(GameBoy, read_pages), false, index, cycles);
+            emit(e, 0x0F); emit(e, 0xB6); emit(e, 0x04); emit(e, 0x02); // movzx eax, byte [rdx + rax]
+            emit_store8(e, JIT_EAX, offsetof(Processor, a));
+        }
+        else {
+            emit_page(e, offsetof(GameBoy, write_pages), false, index, cycles);
+            emit_load8(e, JIT_ECX, offsetof(Processor, a));
+            emit(e, 0x88); emit(e, 0x0C); emit(e, 0x02);             // mov [rdx + rax], cl
+        }
+        return 4;
+    }
+
+    emit_call(e, op);
+    return op->prefixed ? 2 : 1;
+}
+
+// Takes a branch back to the first op, staying in native code while nothing can fire during another pass
+static void jit_emit_loop(JitEmitter * const e, uint16_t target, size_t cycles) {
+    emit(e, 0x49); emit(e, 0x8B); emit(e, 0x8C); emit(e, 0x24); emit32(e, offsetof(GameBoy, scheduler)); // mov rcx, [r12 + offset]
+    emit(e, 0x48); emit(e, 0x81); emit(e, 0x81); emit32(e, offsetof(Scheduler, clock)); emit32(e, cycles); // add qword [rcx + offset], imm32
+    emit(e, 0x48); emit(e, 0x8B); emit(e, 0x81); emit32(e, offsetof(Scheduler, clock)); // mov rax, [rcx + offset]
+    emit(e, 0x48); emit(e, 0x05); emit32(e, e->total);               // add rax, imm32
+    emit(e, 0x48); emit(e, 0x3B); emit(e, 0x81); emit32(e, offsetof(Scheduler, next)); // cmp rax, [rcx + offset]
+    emit(e, 0x0F); emit(e, 0x82);                                    // jb rel32
+    emit32(e, 0);
+    emit_patch(e, e->length - 4, e->loop);
+
+    emit_store16_imm(e, offsetof(Processor, pc), target);
+    emit_exit(e, 0, e->start);
+}
+
+// Emits the branch ending a run, charging the cycles of the path taken
+static void jit_emit_branch(JitEmitter * const e, size_t index, size_t cycles) {
+    ProcessorOp const * const op = &e->block->ops[index];
+    uint8_t opcode = op->opcode;
+    uint16_t next = op->address + op->length;
+
+    if (opcode == 0xE9) {
+        emit_address(e, offsetof(Processor, hl));
+        emit(e, 0x66); emit(e, 0x89); emit(e, 0x83); emit32(e, offsetof(Processor, pc)); // mov [rbx + offset], ax
+        emit_exit(e, cycles + 1, e->start + PROCESSOR_NATIVE_JUMPED);
+        return;
+    }
+
+    bool relative = opcode < 0xC0;
+    uint16_t target = relative ? next + (int8_t)op->operands[0] : op->operands[0] | op->operands[1] << 8;
+    size_t taken = relative ? 3 : 4;
+
+    size_t patch = SIZE_MAX;
+    if (opcode != 0x18 && opcode != 0xC3) {
+        // Bit 3 picks Z/C over NZ/NC, bit 4 picks the carry flag
+        bool set = (opcode & 0x08) != 0;
+        uint8_t mask = (opcode & 0x10) ? PROCESSOR_CARRY_BIT : PROCESSOR_ZERO_BIT;
+        emit(e, 0xF6); emit(e, 0x83); emit32(e, offsetof(Processor, f)); emit(e, mask); // test byte [rbx + offset], imm8
+        emit(e, 0x0F); emit(e, set ? 0x84 : 0x85);                   // jz/jnz rel32
+        patch = e->length;
+        emit32(e, 0);
+    }
+
+    if (target == e->block->ops[e->start].address) {
+        jit_emit_loop(e, target, cycles + taken);
+    }
+    else {
+        emit_store16_imm(e, offsetof(Processor, pc), target);
+        emit_exit(e, cycles + taken, e->start + PROCESSOR_NATIVE_JUMPED);
+    }
+
+    if (patch != SIZE_MAX) {
+        emit_patch(e, patch, e->length);
+        emit_store16_imm(e, offsetof(Processor, pc), next);
+        emit_exit(e, cycles + taken - 1, e->start + PROCESSOR_NATIVE_JUMPED);
+    }
+}
+
+// Translates the run of supported ops starting at index, leaving it interpreted when there is none
+static void jit_translate(Jit * const jit, ProcessorBlock * const block, size_t index) {
+    ProcessorOp * const first = &block->ops[index];
+    first->native = NULL;
+
+    size_t end = index;
+    size_t total = 0;
+    while (end < block->length) {
+        size_t cycles = jit_get_cycles(&block->ops[end]);
+        if (cycles == 0) break;
+        total += cycles;
+        if (jit_is_branch(block->ops[end++].opcode)) break;
+    }
+    if (end == index) return;
+
+    JitEmitter * const e = &(JitEmitter){ .code = jit->buffer + jit->used, .block = block, .start = index, .total = total };
+    emit(e, 0x53);                                                   // push rbx
+    emit(e, 0x41); emit(e, 0x54);                                    // push r12
+    emit(e, 0x41); emit(e, 0x55);                                    // push r13
+    emit(e, 0x49); emit(e, 0x89); emit(e, 0xFC);                     // mov r12, rdi
+    emit(e, 0x48); emit(e, 0x8B); emit(e, 0x9F); emit32(e, offsetof(GameBoy, processor)); // mov rbx, [rdi + offset]
+    emit(e, 0x49); emit(e, 0xBD); emit64(e, (uintptr_t)lahf_flags);  // mov r13, imm64
+    e->loop = e->length;
+
+    size_t cycles = 0;
+    for (size_t i = index; i < end; i++) {
+        ProcessorOp const * const op = &block->ops[i];
+        if (jit_is_branch(op->opcode)) {
+            jit_emit_branch(e, i, cycles);
+            break;
+        }
+        cycles += jit_emit_op(e, i, cycles);
+        if (i == end - 1) {
+            emit_store16_imm(e, offsetof(Processor, pc), op->address + op->length);
+            emit_exit(e, cycles, end);
+        }
+    }
+
+    // Side exits of one op share a stub
+    size_t stub = 0;
+    for (size_t i = 0; i < e->exit_count; i++) {
+        JitExit const * const exit = &e->exits[i];
+        if (i == 0 || exit->index != e->exits[i - 1].index) {
+            stub = e->length;
+            emit_store16_imm(e, offsetof(Processor, pc), block->ops[exit->index].address);
+            emit_exit(e, exit->cycles, exit->index);
+        }
+        emit_patch(e, exit->patch, stub);
+    }
+
+    first->native = (size_t (*)(GameBoy * const, size_t))(jit->buffer + jit->used);
+    first->native_entry = 0;
+    first->native_cycles = total;
+    jit->used += (e->length + 15) & ~(size_t)15;
+}
+
+bool jit_compile(GameBoy * const gb, ProcessorBlock * const block, size_t index) {
+    if (JIT_BUFFER_SIZE - gb->jit->used < JIT_MAX_BLOCK_SIZE) {
+        // Old code can't be told apart from live code, so start over
+        processor_flush_blocks(gb);
+        gb->jit->used = 0;
+        return false;
+    }
+    jit_translate(gb->jit, block, index);
+    return true;
+}
+
+#else
+
+Jit * jit_create(void) {
+    return NULL;
+}
+
+void jit_delete(Jit * jit) {}
+
+bool jit_compile(GameBoy * const gb, ProcessorBlock * const block, size_t index) {
+    return true;
+}
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef TRTLE_JIT_H
+#define TRTLE_JIT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define JIT_BUFFER_SIZE    (4 * 1024 * 1024)
+#define JIT_MAX_BLOCK_SIZE (8192)
+
+typedef struct GameBoy GameBoy;
+typedef struct ProcessorBlock ProcessorBlock;
+
+typedef struct Jit {
+    uint8_t * buffer;
+    size_t used;
+} Jit;
+
+Jit * jit_create(void);
+void jit_delete(Jit * jit);
+
+// Fills in host code for the op at index, returns false when the code buffer had to be flushed instead
+bool jit_compile(GameBoy * const gb, ProcessorBlock * const block, size_t index);
+
+#endif /* !TRTLE_JIT_H */
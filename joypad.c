@@ -37,7 +37,7 @@ static void joypad_update_internal(GameBoy * const gb) {
     }
     input &= P1_BIT_READONLY;
 
-    if (prev != input) gb->interrupt_controller->flags |= JOYPAD_INTERRUPT_BIT;
+    if (prev != input) interrupt_controller_request(gb, JOYPAD_INTERRUPT_BIT);
 
     gb->joypad->p1 &= ~P1_BIT_READONLY;
     gb->joypad->p1 |= input;
@@ -14,6 +14,9 @@
 
 #define TRTLE_LOGGING_VERBOSE
 #include "trtle.h"
+#ifdef TRTLE_AOT
+#include "aot.h"
+#endif
 
 static GameBoy * gameboy;
 static Cartridge * cart;
@@ -26,6 +29,10 @@ static retro_audio_sample_t audio_cb;
 static retro_audio_sample_batch_t audio_batch_cb;
 static retro_input_poll_t input_poll_cb;
 static retro_input_state_t input_state_cb;
+static bool timing_listed;
+
+// Lines of the allow-list in the system directory are cartridge IDs, # starts a comment
+#define TIMING_LIST_NAME "trtle_timing.txt"
 
 static void fallback_log(enum retro_log_level level, const char* fmt, ...) {
     (void)level;
@@ -35,6 +42,63 @@ static void fallback_log(enum retro_log_level level, const char* fmt, ...) {
     va_end(va);
 }
 
+// Applies the core options, the JIT one only exists in builds with TRTLE_JIT
+static void check_variables(void) {
+    struct retro_variable timing = { "trtle_timing", NULL };
+    bool coarse = environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &timing) && timing.value
+        && (strcmp(timing.value, "instruction") == 0 || (strcmp(timing.value, "allow-list") == 0 && timing_listed));
+    gameboy_set_instruction_timing(gameboy, coarse);
+
+#ifdef TRTLE_JIT
+    struct retro_variable var = { "trtle_jit", NULL };
+    bool enabled = environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value && strcmp(var.value, "enabled") == 0;
+    if (gameboy_set_jit(gameboy, enabled) != enabled) log_cb(RETRO_LOG_WARN, "The JIT is not available, falling back to the interpreter.\n");
+#endif
+}
+
+// Checks the allow-list of ROMs that run the same with instruction timing, trtle_timing prints its lines
+static bool check_timing_list(Cartridge const * cart) {
+    char const * directory = NULL;
+    if (!environ_cb(RETRO_ENVIRONMENT_GET_SYSTEM_DIRECTORY, &directory) || directory == NULL) return false;
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", directory, TIMING_LIST_NAME);
+    FILE * file = fopen(path, "r");
+    if (file == NULL) return false;
+
+    char id[CARTRIDGE_ID_LENGTH];
+    cartridge_get_id(cart, id);
+
+    bool listed = false;
+    char line[256];
+    while (!listed && id[0] != '\0' && fgets(line, sizeof(line), file) != NULL) {
+        line[strcspn(line, "#\r\n")] = '\0';
+        size_t length = strlen(line);
+        while (length > 0 && line[length - 1] == ' ') line[--length] = '\0';
+        listed = strcmp(line, id) == 0;
+    }
+    fclose(file);
+    return listed;
+}
+
+#ifdef TRTLE_AOT
+// Looks for a module built by trtle_aot next to the ROM, game.gb pairs with game.aot.so
+static void load_aot(char const * rom_path) {
+    if (rom_path == NULL) return;
+
+    char const * name = strrchr(rom_path, '/');
+    char const * extension = strrchr(name != NULL ? name : rom_path, '.');
+    size_t length = extension != NULL ? (size_t)(extension - rom_path) : strlen(rom_path);
+
+    char * path = malloc(length + sizeof(AOT_EXTENSION));
+    if (path == NULL) return;
+    memcpy(path, rom_path, length);
+    memcpy(path + length, AOT_EXTENSION, sizeof(AOT_EXTENSION));
+    if (gameboy_load_aot(gameboy, path)) log_cb(RETRO_LOG_INFO, "Loaded AOT module %s.\n", path);
+    free(path);
+}
+#endif
+
 void retro_init(void) {
     gameboy = gameboy_create();
     frame_buf = calloc(GAMEBOY_DISPLAY_PIXEL_COUNT, sizeof(uint32_t));
@@ -98,6 +162,15 @@ void retro_set_environment(retro_environment_t cb) {
     };
 
     cb(RETRO_ENVIRONMENT_SET_CONTROLLER_INFO, (void*)ports);
+
+    static const struct retro_variable vars[] = {
+        { "trtle_timing", "CPU timing; accurate|allow-list|instruction" },
+#ifdef TRTLE_JIT
+        { "trtle_jit", "JIT recompiler; enabled|disabled" },
+#endif
+        { NULL, NULL },
+    };
+    cb(RETRO_ENVIRONMENT_SET_VARIABLES, (void*)vars);
 }
 
 void retro_set_audio_sample(retro_audio_sample_t cb) {
@@ -125,6 +198,9 @@ void retro_reset(void) {
 }
 
 void retro_run(void) {
+    bool updated = false;
+    if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE, &updated) && updated) check_variables();
+
     input_poll_cb();
     GameBoyInput input = {
         input_state_cb(0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_A),
@@ -164,19 +240,28 @@ bool retro_load_game(const struct retro_game_info *info) {
     }
 
     if (info && info->data) {
-        CartridgeError error = cartridge_from_memory(&gameboy->cartridge, info->data, info->size);
+        CartridgeError error = cartridge_from_memory(&cart, info->data, info->size);
         if (error) {
             log_cb(RETRO_LOG_ERROR, "Error loading cartridge: %i.\n", error);
             return false;
         }
+        gameboy_set_cartridge(gameboy, cart);
+        timing_listed = check_timing_list(cart);
+        if (timing_listed) log_cb(RETRO_LOG_INFO, "Found the ROM in %s.\n", TIMING_LIST_NAME);
+#ifdef TRTLE_AOT
+        load_aot(info->path);
+#endif
     }
 
+    check_variables();
     return true;
 }
 
 void retro_unload_game(void) {
+    timing_listed = false;
     gameboy_set_cartridge(gameboy, NULL);
     cartridge_delete(cart);
+    cart = NULL;
 }
 
 unsigned retro_get_region(void) {
@@ -2,6 +2,7 @@
 
 #include "gameboy.h"
 #include "interrupt_controller.h"
+#include "scheduler.h"
 
 typedef enum LCDCBit {
     LCDC_LCD_ENABLE_BIT           = 0b10000000,
@@ -69,6 +70,7 @@ void ppu_initialize(PPU * const ppu, bool skip_bootrom) {
     ppu->window_internal_line = 0;
 
     ppu->count = 80;
+    ppu->last_sync = 0;
 }
 
 size_t scx_cycle_offsets[] = {
@@ -88,9 +90,9 @@ static void ppu_vblank_enter(GameBoy * const gb) {
 
     gb->ppu->window_internal_line = 0;
 
-    gb->interrupt_controller->flags |= VBLANK_INTERRUPT_BIT;
+    interrupt_controller_request(gb, VBLANK_INTERRUPT_BIT);
     if ((gb->ppu->stat & STAT_VBLANK_CHECK_ENABLE) || (gb->ppu->stat & STAT_OAM_SEARCH_CHECK_ENABLE)) {
-        gb->interrupt_controller->flags |= LCD_STAT_INTERRUPT_BIT;
+        interrupt_controller_request(gb, LCD_STAT_INTERRUPT_BIT);
     }
 }
 
@@ -100,7 +102,7 @@ static void ppu_oam_search_enter(GameBoy * const gb) {
     gb->ppu->count += PPU_OAM_SEARCH_LENGTH;
 
     if (gb->ppu->stat & STAT_OAM_SEARCH_CHECK_ENABLE) {
-        gb->interrupt_controller->flags |= LCD_STAT_INTERRUPT_BIT;
+        interrupt_controller_request(gb, LCD_STAT_INTERRUPT_BIT);
     }
 }
 
@@ -117,7 +119,7 @@ static void ppu_compare_ly_lyc(GameBoy * const gb) {
     else {
         gb->ppu->stat |= STAT_LY_LYC_COMPARISON_SIGNAL;
         if (gb->ppu->stat & STAT_LY_LYC_COMPARSION_ENABLE) {
-            gb->interrupt_controller->flags |= LCD_STAT_INTERRUPT_BIT;
+            interrupt_controller_request(gb, LCD_STAT_INTERRUPT_BIT);
         }
     }
 }
@@ -233,41 +235,61 @@ static void ppu_draw_line(GameBoy * const gb) {
     }
 }
 
-void ppu_cycle(GameBoy * const gb) {
-    if (!(gb->ppu->lcdc & LCDC_LCD_ENABLE_BIT)) return;
-
-    gb->ppu->count--;
-    if (gb->ppu->count == 1 && (gb->ppu->stat & STAT_MODE_BITS) == GRAPHICS_MODE_DATA_TRANSFER) {
-        if (gb->ppu->stat & STAT_HBLANK_CHECK_ENABLE) gb->interrupt_controller->flags |= LCD_STAT_INTERRUPT_BIT;
+// Schedules the next cycle with an observable side effect, which is either the HBlank STAT check
+// one cycle before the end of data transfer or the next mode change
+static void ppu_schedule(GameBoy * const gb) {
+    if (!(gb->ppu->lcdc & LCDC_LCD_ENABLE_BIT)) {
+        scheduler_cancel(gb, SCHEDULER_EVENT_PPU);
+        return;
     }
 
-    if (gb->ppu->count != 0) return;
+    size_t cycles = gb->ppu->count;
+    if ((gb->ppu->stat & STAT_MODE_BITS) == GRAPHICS_MODE_DATA_TRANSFER && cycles >= 2) cycles--;
+    scheduler_schedule(gb, SCHEDULER_EVENT_PPU, gb->scheduler->clock + cycles);
+}
+
+// Brings the mode counter up to the current clock, the rest of the state only changes on events
+void ppu_sync(GameBoy * const gb) {
+    if (gb->ppu->lcdc & LCDC_LCD_ENABLE_BIT) gb->ppu->count -= gb->scheduler->clock - gb->ppu->last_sync;
+    gb->ppu->last_sync = gb->scheduler->clock;
+}
 
-    switch (gb->ppu->stat & STAT_MODE_BITS) {
-        case GRAPHICS_MODE_HBLANK: {
-            if (++gb->ppu->ly < 144) ppu_oam_search_enter(gb);
-            else ppu_vblank_enter(gb);
-            ppu_compare_ly_lyc(gb);
-        } break;
+void ppu_event(GameBoy * const gb) {
+    ppu_sync(gb);
 
-        case GRAPHICS_MODE_VBLANK: {
-            if (++gb->ppu->ly > 153) {
-                gb->ppu->ly = 0;
-                ppu_oam_search_enter(gb);
-            }
-            else gb->ppu->count += PPU_VBLANK_LENGTH;
-            ppu_compare_ly_lyc(gb);
-        } break;
-
-        case GRAPHICS_MODE_OAM_SEARCH: {
-            ppu_data_transfer_enter(gb);
-        } break;
-
-        case GRAPHICS_MODE_DATA_TRANSFER: {
-            ppu_draw_line(gb);
-            ppu_hblank_enter(gb);
-        } break;
+    if (gb->ppu->count == 1 && (gb->ppu->stat & STAT_MODE_BITS) == GRAPHICS_MODE_DATA_TRANSFER) {
+        if (gb->ppu->stat & STAT_HBLANK_CHECK_ENABLE) interrupt_controller_request(gb, LCD_STAT_INTERRUPT_BIT);
+    }
+
+    if (gb->ppu->count == 0) {
+        switch (gb->ppu->stat & STAT_MODE_BITS) {
+            case GRAPHICS_MODE_HBLANK: {
+                if (++gb->ppu->ly < 144) ppu_oam_search_enter(gb);
+                else ppu_vblank_enter(gb);
+                ppu_compare_ly_lyc(gb);
+            } break;
+
+            case GRAPHICS_MODE_VBLANK: {
+                if (++gb->ppu->ly > 153) {
+                    gb->ppu->ly = 0;
+                    ppu_oam_search_enter(gb);
+                }
+                else gb->ppu->count += PPU_VBLANK_LENGTH;
+                ppu_compare_ly_lyc(gb);
+            } break;
+
+            case GRAPHICS_MODE_OAM_SEARCH: {
+                ppu_data_transfer_enter(gb);
+            } break;
+
+            case GRAPHICS_MODE_DATA_TRANSFER: {
+                ppu_draw_line(gb);
+                ppu_hblank_enter(gb);
+            } break;
+        }
     }
+
+    ppu_schedule(gb);
 }
 
 uint8_t ppu_read_lcdc(GameBoy const * const gb) {
@@ -275,12 +297,17 @@ uint8_t ppu_read_lcdc(GameBoy const * const gb) {
 }
 
 void ppu_write_lcdc(GameBoy * const gb, uint8_t value) {
+    ppu_sync(gb);
+
     if (!(value & LCDC_LCD_ENABLE_BIT)) {
         gb->ppu->ly = 0;
         gb->ppu->count = 115;
         gb->ppu->stat = gb->ppu->stat & 0b11111100;
     }
     gb->ppu->lcdc = value;
+
+    ppu_schedule(gb);
+    gameboy_update_run_state(gb);
 }
 
 uint8_t ppu_read_stat(GameBoy const * const gb) {
@@ -333,6 +360,10 @@ GraphicsMode ppu_get_mode(GameBoy const * const gb) {
     return gb->ppu->stat & STAT_MODE_BITS;
 }
 
+bool ppu_is_enabled(GameBoy const * const gb) {
+    return gb->ppu->lcdc & LCDC_LCD_ENABLE_BIT;
+}
+
 uint32_t get_pixel_color(uint8_t color_code) {
     switch (color_code) {
         case 0: return 0xF5F5F5F5;
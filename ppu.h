@@ -2,6 +2,7 @@
 #define TRTLE_PPU_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #define PPU_ROWS_PER_TILE       (8)
@@ -50,11 +51,13 @@ typedef struct PPU {
     uint8_t display_buffer[PPU_DISPLAY_WIDTH * PPU_DISPLAY_HEIGHT];
 
     size_t count;
+    uint64_t last_sync;
 } PPU;
 
 void ppu_initialize(PPU * const ppu, bool skip_bootrom);
 
-void ppu_cycle(GameBoy * const gb);
+void ppu_sync(GameBoy * const gb);
+void ppu_event(GameBoy * const gb);
 
 uint8_t ppu_read_lcdc(GameBoy const * const gb);
 void ppu_write_lcdc(GameBoy * const gb, uint8_t value);
@@ -69,6 +72,7 @@ uint8_t ppu_read_vram(GameBoy const * const gb, uint16_t address);
 void ppu_write_vram(GameBoy * const gb, uint16_t address, uint8_t value);
 
 GraphicsMode ppu_get_mode(GameBoy const * const gb);
+bool ppu_is_enabled(GameBoy const * const gb);
 
 size_t ppu_get_background_data(GameBoy const* const gb, uint32_t data[], size_t length);
 size_t ppu_get_display_data(GameBoy const* const gb, uint32_t data[], size_t length);
@@ -1,8 +1,16 @@
 #include "processor.h"
 
+#include <string.h>
+
+#include "aot.h"
+#include "dma.h"
 #include "gameboy.h"
 #include "interrupt_controller.h"
+#ifdef TRTLE_JIT
+#include "jit.h"
+#endif
 #include "logger.h"
+#include "scheduler.h"
 
 #define INTERRUPT_FLAGS_ADDRESS  (0xFF0F)
 #define INTERRUPT_ENABLE_ADDRESS (0xFFFF)
@@ -22,6 +30,164 @@ void processor_initialize(Processor * const p, bool skip_bootrom) {
     p->halt_mode = false;
     p->skip_pc_increment = false;
     p->skip_next_interrupt = false;
+#ifdef TRTLE_LAZY_FLAGS
+    p->lazy_flags = 0;
+#endif
+
+    p->operands = NULL;
+    p->block = NULL;
+    p->block_index = 0;
+    p->step.kind = PROCESSOR_STEP_NONE;
+    p->stepping = false;
+    p->replaying = false;
+    p->idle_block = NULL;
+    memset(p->ram_code_pages, 0, sizeof(p->ram_code_pages));
+    memset(p->code_map, 0, sizeof(p->code_map));
+    for (size_t i = 0; i < PROCESSOR_BLOCK_COUNT; i++) {
+        p->blocks[i].code = NULL;
+        p->blocks[i].end = NULL;
+        p->blocks[i].length = 0;
+    }
+}
+
+// Bus accesses of the instruction handlers. The stepping CPU latches every read of a unit, and while
+// it replays one the latched reads stand in for the bus and writes, which already happened, are dropped.
+static inline uint8_t processor_read(GameBoy * const gb, uint16_t address) {
+    Processor * const p = gb->processor;
+    if (!p->stepping) return gameboy_read(gb, address);
+    if (p->replaying) return p->replay_index < p->step.read_count ? p->step.reads[p->replay_index++] : 0xFF;
+
+    uint8_t value = gameboy_read(gb, address);
+    if (p->step.read_count < PROCESSOR_STEP_READS) p->step.reads[p->step.read_count++] = value;
+    return value;
+}
+
+static inline void processor_write(GameBoy * const gb, uint16_t address, uint8_t value) {
+    if (!gb->processor->replaying) gameboy_write(gb, address, value);
+}
+
+// Reads the next instruction byte, from the decoded operands when running a cached block
+static uint8_t processor_fetch(GameBoy * const gb) {
+    uint8_t value = gb->processor->operands != NULL ? *gb->processor->operands++ : processor_read(gb, gb->processor->pc);
+    gb->processor->pc += 1;
+    return value;
+}
+
+// ALU flags. With TRTLE_LAZY_FLAGS the Z, H and C bits named in lazy_flags are left out of f and
+// worked out from the last result when something reads them: bit 4 of operands ^ result is the
+// half carry and bit 8 of the result is the carry.
+#ifdef TRTLE_LAZY_FLAGS
+static inline void processor_fold_flags(Processor * const p) {
+    if (p->lazy_flags == 0) return;
+    if ((p->lazy_flags & PROCESSOR_ZERO_BIT) && (p->flags_result & 0xFF) == 0) p->f |= PROCESSOR_ZERO_BIT;
+    if (p->lazy_flags & PROCESSOR_HALF_BIT) p->f |= ((p->flags_operands ^ p->flags_result) << 1) & PROCESSOR_HALF_BIT;
+    if (p->lazy_flags & PROCESSOR_CARRY_BIT) p->f |= (p->flags_result >> 4) & PROCESSOR_CARRY_BIT;
+    p->lazy_flags = 0;
+}
+
+static inline bool processor_zero(Processor const * const p) {
+    if (p->lazy_flags & PROCESSOR_ZERO_BIT) return (p->flags_result & 0xFF) == 0;
+    return (p->f & PROCESSOR_ZERO_BIT) != 0;
+}
+
+static inline uint8_t processor_carry(Processor const * const p) {
+    if (p->lazy_flags & PROCESSOR_CARRY_BIT) return (p->flags_result >> 8) & 1;
+    return (p->f & PROCESSOR_CARRY_BIT) != 0;
+}
+
+static inline uint8_t processor_add(Processor * const p, uint8_t x, uint8_t y, uint8_t carry) {
+    p->flags_result = x + y + carry;
+    p->flags_operands = x ^ y;
+    p->f = 0;
+    p->lazy_flags = PROCESSOR_ZERO_BIT | PROCESSOR_HALF_BIT | PROCESSOR_CARRY_BIT;
+    return p->flags_result;
+}
+
+static inline uint8_t processor_sub(Processor * const p, uint8_t x, uint8_t y, uint8_t carry) {
+    p->flags_result = x - y - carry;
+    p->flags_operands = x ^ y;
+    p->f = PROCESSOR_NEGATIVE_BIT;
+    p->lazy_flags = PROCESSOR_ZERO_BIT | PROCESSOR_HALF_BIT | PROCESSOR_CARRY_BIT;
+    return p->flags_result;
+}
+
+static inline uint8_t processor_inc(Processor * const p, uint8_t x) {
+    p->f = processor_carry(p) ? PROCESSOR_CARRY_BIT : 0;
+    p->flags_result = x + 1;
+    p->flags_operands = x ^ 1;
+    p->lazy_flags = PROCESSOR_ZERO_BIT | PROCESSOR_HALF_BIT;
+    return p->flags_result;
+}
+
+static inline uint8_t processor_dec(Processor * const p, uint8_t x) {
+    p->f = PROCESSOR_NEGATIVE_BIT | (processor_carry(p) ? PROCESSOR_CARRY_BIT : 0);
+    p->flags_result = x - 1;
+    p->flags_operands = x ^ 1;
+    p->lazy_flags = PROCESSOR_ZERO_BIT | PROCESSOR_HALF_BIT;
+    return p->flags_result;
+}
+
+static inline uint8_t processor_logic(Processor * const p, uint8_t result, uint8_t half) {
+    p->f = half;
+    p->flags_result = result;
+    p->lazy_flags = PROCESSOR_ZERO_BIT;
+    return result;
+}
+#else
+static inline void processor_fold_flags(Processor * const p) {}
+
+static inline bool processor_zero(Processor const * const p) {
+    return (p->f & PROCESSOR_ZERO_BIT) != 0;
+}
+
+static inline uint8_t processor_carry(Processor const * const p) {
+    return (p->f & PROCESSOR_CARRY_BIT) != 0;
+}
+
+static inline uint8_t processor_add(Processor * const p, uint8_t x, uint8_t y, uint8_t carry) {
+    uint16_t result = x + y + carry;
+    p->f = 0;
+    if (((x & 0x0F) + (y & 0x0F) + carry) & 0x10) p->f |= PROCESSOR_HALF_BIT;
+    if ((result & 0xFF) == 0) p->f |= PROCESSOR_ZERO_BIT;
+    if (result > 0xFF) p->f |= PROCESSOR_CARRY_BIT;
+    return result;
+}
+
+static inline uint8_t processor_sub(Processor * const p, uint8_t x, uint8_t y, uint8_t carry) {
+    uint32_t result = (uint32_t)x - y - carry;
+    p->f = PROCESSOR_NEGATIVE_BIT;
+    if ((x & 0x0F) < (y & 0x0F) + carry) p->f |= PROCESSOR_HALF_BIT;
+    if ((result & 0xFF) == 0) p->f |= PROCESSOR_ZERO_BIT;
+    if (result > 0xFF) p->f |= PROCESSOR_CARRY_BIT;
+    return result;
+}
+
+static inline uint8_t processor_inc(Processor * const p, uint8_t x) {
+    x += 1;
+    p->f &= PROCESSOR_CARRY_BIT;
+    if ((x & 0x0F) == 0) p->f |= PROCESSOR_HALF_BIT;
+    if (x == 0) p->f |= PROCESSOR_ZERO_BIT;
+    return x;
+}
+
+static inline uint8_t processor_dec(Processor * const p, uint8_t x) {
+    x -= 1;
+    p->f &= PROCESSOR_CARRY_BIT;
+    p->f |= PROCESSOR_NEGATIVE_BIT;
+    if ((x & 0x0F) == 0x0F) p->f |= PROCESSOR_HALF_BIT;
+    if (x == 0) p->f |= PROCESSOR_ZERO_BIT;
+    return x;
+}
+
+static inline uint8_t processor_logic(Processor * const p, uint8_t result, uint8_t half) {
+    p->f = half;
+    if (result == 0) p->f |= PROCESSOR_ZERO_BIT;
+    return result;
+}
+#endif
+
+void processor_sync_flags(GameBoy * const gb) {
+    processor_fold_flags(gb->processor);
 }
 
 #define LD_R_R(reg1, reg2)\
@@ -31,130 +197,124 @@ static void ld_##reg1##_##reg2(GameBoy * const gb) {\
 
 #define LD_R_D8(reg)\
 static void ld_##reg##_d8(GameBoy * const gb) {\
-    gb->processor->reg = gameboy_read(gb, gb->processor->pc);\
-    gb->processor->pc += 1;\
+    gb->processor->reg = processor_fetch(gb);\
     gameboy_cycle(gb);\
 }
 
 #define LD_R_DHL(reg)\
 static void ld_##reg##_dhl(GameBoy * const gb) {\
-    gb->processor->reg = gameboy_read(gb, gb->processor->hl);\
+    gb->processor->reg = processor_read(gb, gb->processor->hl);\
     gameboy_cycle(gb);\
 }
 
 #define LD_DHL_R(reg)\
 static void ld_dhl_##reg(GameBoy * const gb) {\
-    gameboy_write(gb, gb->processor->hl, gb->processor->reg);\
+    processor_write(gb, gb->processor->hl, gb->processor->reg);\
     gameboy_cycle(gb);\
 }
 
 static void ld_dhl_d8(GameBoy * const gb) {
-    uint8_t val = gameboy_read(gb, gb->processor->pc);
-    gb->processor->pc += 1;
+    uint8_t val = processor_fetch(gb);
     gameboy_cycle(gb);
-    gameboy_write(gb, gb->processor->hl, val);
+    processor_write(gb, gb->processor->hl, val);
     gameboy_cycle(gb);
 }
 
 #define LD_A_DRR(reg)\
 static void ld_a_d##reg(GameBoy * const gb) {\
-    gb->processor->a = gameboy_read(gb, gb->processor->reg);\
+    gb->processor->a = processor_read(gb, gb->processor->reg);\
     gameboy_cycle(gb);\
 }
 
 #define LD_DRR_A(reg)\
 static void ld_d##reg##_a(GameBoy * const gb) {\
-    gameboy_write(gb, gb->processor->reg, gb->processor->a);\
+    processor_write(gb, gb->processor->reg, gb->processor->a);\
     gameboy_cycle(gb);\
 }
 
 static void ld_a_da16(GameBoy * const gb) {
-    uint16_t addr = gameboy_read(gb, gb->processor->pc);
-    gb->processor->pc += 1;
+    uint16_t addr = processor_fetch(gb);
     gameboy_cycle(gb);
-    addr |= gameboy_read(gb, gb->processor->pc) << 8;
-    gb->processor->pc += 1;
+    addr |= processor_fetch(gb) << 8;
     gameboy_cycle(gb);
-    gb->processor->a = gameboy_read(gb, addr);
+    gb->processor->a = processor_read(gb, addr);
     gameboy_cycle(gb);
 }
 
 static void ld_da16_a(GameBoy * const gb) {
-    uint16_t addr = gameboy_read(gb, gb->processor->pc);
-    gb->processor->pc += 1;
+    uint16_t addr = processor_fetch(gb);
     gameboy_cycle(gb);
-    addr |= gameboy_read(gb, gb->processor->pc) << 8;
-    gb->processor->pc += 1;
+    addr |= processor_fetch(gb) << 8;
     gameboy_cycle(gb);
-    gameboy_write(gb, addr, gb->processor->a);
+    processor_write(gb, addr, gb->processor->a);
     gameboy_cycle(gb);
 }
 
 static void ldh_a_dc(GameBoy * const gb) {
-    gb->processor->a = gameboy_read(gb, 0xFF00 | gb->processor->c);
+    gb->processor->a = processor_read(gb, 0xFF00 | gb->processor->c);
     gameboy_cycle(gb);
 }
 
 static void ldh_dc_a(GameBoy * const gb) {
-    gameboy_write(gb, 0xFF00 | gb->processor->c, gb->processor->a);
+    processor_write(gb, 0xFF00 | gb->processor->c, gb->processor->a);
     gameboy_cycle(gb);
 }
 
 static void ldh_a_da8(GameBoy * const gb) {
-    uint16_t addr = 0xFF00 | gameboy_read(gb, gb->processor->pc++);
+    uint16_t addr = 0xFF00 | processor_fetch(gb);
     gameboy_cycle(gb);
-    gb->processor->a = gameboy_read(gb, addr);
+    gb->processor->a = processor_read(gb, addr);
     gameboy_cycle(gb);
 }
 
 static void ldh_da8_a(GameBoy * const gb) {
-    uint16_t addr = 0xFF00 | gameboy_read(gb, gb->processor->pc++);
+    uint16_t addr = 0xFF00 | processor_fetch(gb);
     gameboy_cycle(gb);
-    gameboy_write(gb, addr, gb->processor->a);
+    processor_write(gb, addr, gb->processor->a);
     gameboy_cycle(gb);
 }
 
 static void ld_a_dhld(GameBoy * const gb) {
-    gb->processor->a = gameboy_read(gb, gb->processor->hl);
+    gb->processor->a = processor_read(gb, gb->processor->hl);
     gb->processor->hl -= 1;
     gameboy_cycle(gb);
 }
 
 static void ld_dhld_a(GameBoy * const gb) {
-    gameboy_write(gb, gb->processor->hl, gb->processor->a);
+    processor_write(gb, gb->processor->hl, gb->processor->a);
     gb->processor->hl -= 1;
     gameboy_cycle(gb);
 }
 
 static void ld_a_dhli(GameBoy * const gb) {
-    gb->processor->a = gameboy_read(gb, gb->processor->hl);
+    gb->processor->a = processor_read(gb, gb->processor->hl);
     gb->processor->hl += 1;
     gameboy_cycle(gb);
 }
 
 static void ld_dhli_a(GameBoy * const gb) {
-    gameboy_write(gb, gb->processor->hl, gb->processor->a);
+    processor_write(gb, gb->processor->hl, gb->processor->a);
     gb->processor->hl += 1;
     gameboy_cycle(gb);
 }
 
 #define LD_RR_D16(reg)\
 static void ld_##reg##_d16(GameBoy * const gb) {\
-    uint16_t val = gameboy_read(gb, gb->processor->pc++);\
+    uint16_t val = processor_fetch(gb);\
     gameboy_cycle(gb);\
-    val |= gameboy_read(gb, gb->processor->pc++) << 8;\
+    val |= processor_fetch(gb) << 8;\
     gameboy_cycle(gb);\
     gb->processor->reg = val;\
 }
 
 static void ld_da16_sp(GameBoy * const gb) {
-    uint16_t addr = gameboy_read(gb, gb->processor->pc++);
+    uint16_t addr = processor_fetch(gb);
     gameboy_cycle(gb);
-    addr |= gameboy_read(gb, gb->processor->pc++) << 8;
+    addr |= processor_fetch(gb) << 8;
     gameboy_cycle(gb);
-    gameboy_write(gb, addr, (gb->processor->sp) & 0x00FF);
+    processor_write(gb, addr, (gb->processor->sp) & 0x00FF);
     gameboy_cycle(gb);
-    gameboy_write(gb, addr + 1, (gb->processor->sp) >> 8);
+    processor_write(gb, addr + 1, (gb->processor->sp) >> 8);
     gameboy_cycle(gb);
 }
 
@@ -166,338 +326,213 @@ static void ld_sp_hl(GameBoy * const gb) {
 #define PUSH_RR(reg)\
 static void push_##reg(GameBoy * const gb) {\
     gameboy_cycle(gb);\
-    gameboy_write(gb, --gb->processor->sp, gb->processor->reg >> 8);\
+    processor_write(gb, --gb->processor->sp, gb->processor->reg >> 8);\
     gameboy_cycle(gb);\
-    gameboy_write(gb, --gb->processor->sp, gb->processor->reg & 0x00FF);\
+    processor_write(gb, --gb->processor->sp, gb->processor->reg & 0x00FF);\
     gameboy_cycle(gb);\
 }
 
 #define POP_RR(reg)\
 static void pop_##reg(GameBoy * const gb) {\
-    uint16_t val = gameboy_read(gb, gb->processor->sp++);\
+    uint16_t val = processor_read(gb, gb->processor->sp++);\
     gameboy_cycle(gb);\
-    val |= gameboy_read(gb, gb->processor->sp++) << 8;\
+    val |= processor_read(gb, gb->processor->sp++) << 8;\
     gameboy_cycle(gb);\
     gb->processor->reg = val;\
 }
 
 static void pop_af(GameBoy * const gb) {
-    uint16_t val = gameboy_read(gb, gb->processor->sp++);
+    processor_fold_flags(gb->processor);
+    uint16_t val = processor_read(gb, gb->processor->sp++);
     gameboy_cycle(gb);
-    val |= gameboy_read(gb, gb->processor->sp++) << 8;
+    val |= processor_read(gb, gb->processor->sp++) << 8;
     gameboy_cycle(gb);
     gb->processor->af = val & 0xFFF0;
 }
 
+static void push_af(GameBoy * const gb) {
+    processor_fold_flags(gb->processor);
+    gameboy_cycle(gb);
+    processor_write(gb, --gb->processor->sp, gb->processor->a);
+    gameboy_cycle(gb);
+    processor_write(gb, --gb->processor->sp, gb->processor->f);
+    gameboy_cycle(gb);
+}
+
 #define INC_R(reg)\
 static void inc_##reg(GameBoy * const gb) {\
-    gb->processor->reg += 1;\
-\
-    gb->processor->f &= PROCESSOR_CARRY_BIT;\
-    if ((gb->processor->reg & 0x0F) == 0) gb->processor->f |= PROCESSOR_HALF_BIT;\
-    if (gb->processor->reg == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;\
+    gb->processor->reg = processor_inc(gb->processor, gb->processor->reg);\
 }
 
 #define DEC_R(reg)\
 static void dec_##reg(GameBoy * const gb) {\
-    gb->processor->reg -= 1;\
-\
-    gb->processor->f &= PROCESSOR_CARRY_BIT;\
-    gb->processor->f |= PROCESSOR_NEGATIVE_BIT;\
-    if ((gb->processor->reg & 0x0F) == 0x0F) gb->processor->f |= PROCESSOR_HALF_BIT;\
-    if (gb->processor->reg == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;\
+    gb->processor->reg = processor_dec(gb->processor, gb->processor->reg);\
 }
 
 #define ADD_A_R(reg)\
 static void add_a_##reg(GameBoy * const gb) {\
-    uint8_t initial = gb->processor->a;\
-    uint8_t add = gb->processor->reg;\
-\
-    gb->processor->a += add;\
-\
-    gb->processor->f = 0;\
-    if (((initial & 0x0F) + (add & 0x0F)) & 0x10) gb->processor->f |= PROCESSOR_HALF_BIT;\
-    if (gb->processor->a == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;\
-    if (((uint16_t)initial) + ((uint16_t)add) > 0xFF) gb->processor->f |= PROCESSOR_CARRY_BIT;\
+    gb->processor->a = processor_add(gb->processor, gb->processor->a, gb->processor->reg, 0);\
 }
 
 static void add_a_dhl(GameBoy * const gb) {
-    uint8_t initial = gb->processor->a;
-    uint8_t add = gameboy_read(gb, gb->processor->hl);
+    uint8_t add = processor_read(gb, gb->processor->hl);
     gameboy_cycle(gb);
 
-    gb->processor->a += add;
-
-    gb->processor->f = 0;
-    if (((initial & 0x0F) + (add & 0x0F)) & 0x10) gb->processor->f |= PROCESSOR_HALF_BIT;
-    if (gb->processor->a == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;
-    if (((uint16_t)initial) + ((uint16_t)add) > 0xFF) gb->processor->f |= PROCESSOR_CARRY_BIT;
+    gb->processor->a = processor_add(gb->processor, gb->processor->a, add, 0);
 }
 
 static void add_a_d8(GameBoy * const gb) {
-    uint8_t initial = gb->processor->a;
-    uint8_t add = gameboy_read(gb, gb->processor->pc);
-    gb->processor->pc += 1;
+    uint8_t add = processor_fetch(gb);
     gameboy_cycle(gb);
 
-    gb->processor->a += add;
-
-    gb->processor->f = 0;
-    if (((initial & 0x0F) + (add & 0x0F)) & 0x10) gb->processor->f |= PROCESSOR_HALF_BIT;
-    if (gb->processor->a == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;
-    if (((uint16_t)initial) + ((uint16_t)add) > 0xFF) gb->processor->f |= PROCESSOR_CARRY_BIT;
+    gb->processor->a = processor_add(gb->processor, gb->processor->a, add, 0);
 }
 
 #define ADC_A_R(reg)\
 static void adc_a_##reg(GameBoy * const gb) {\
-    uint8_t initial = gb->processor->a;\
-    uint8_t add = gb->processor->reg;\
-    uint8_t car = (gb->processor->f & PROCESSOR_CARRY_BIT) != 0;\
-\
-    gb->processor->a += add + car;\
-\
-    gb->processor->f = 0;\
-    if (((initial & 0x0F) + (add & 0x0F) + (car & 0x0F)) & 0x10) gb->processor->f |= PROCESSOR_HALF_BIT;\
-    if (gb->processor->a == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;\
-    if (((uint16_t)initial) + ((uint16_t)add) + ((uint16_t)car) > 0xFF) gb->processor->f |= PROCESSOR_CARRY_BIT;\
+    gb->processor->a = processor_add(gb->processor, gb->processor->a, gb->processor->reg, processor_carry(gb->processor));\
 }
 
 static void adc_a_dhl(GameBoy * const gb) {
-    uint8_t initial = gb->processor->a;
-    uint8_t add = gameboy_read(gb, gb->processor->hl);
+    uint8_t add = processor_read(gb, gb->processor->hl);
     gameboy_cycle(gb);
-    uint8_t car = (gb->processor->f & PROCESSOR_CARRY_BIT) != 0;
-
-    gb->processor->a += add + car;
 
-    gb->processor->f = 0;
-    if (((initial & 0x0F) + (add & 0x0F) + (car & 0x0F)) & 0x10) gb->processor->f |= PROCESSOR_HALF_BIT;
-    if (gb->processor->a == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;
-    if (((uint16_t)initial) + ((uint16_t)add) + ((uint16_t)car) > 0xFF) gb->processor->f |= PROCESSOR_CARRY_BIT;
+    gb->processor->a = processor_add(gb->processor, gb->processor->a, add, processor_carry(gb->processor));
 }
 
 static void adc_a_d8(GameBoy * const gb) {
-    uint8_t initial = gb->processor->a;
-    uint8_t add = gameboy_read(gb, gb->processor->pc);
-    gb->processor->pc += 1;
+    uint8_t add = processor_fetch(gb);
     gameboy_cycle(gb);
-    uint8_t car = (gb->processor->f & PROCESSOR_CARRY_BIT) != 0;
 
-    gb->processor->a += add + car;
-
-    gb->processor->f = 0;
-    if (((initial & 0x0F) + (add & 0x0F) + (car & 0x0F)) & 0x10) gb->processor->f |= PROCESSOR_HALF_BIT;
-    if (gb->processor->a == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;
-    if (((uint16_t)initial) + ((uint16_t)add) + ((uint16_t)car) > 0xFF) gb->processor->f |= PROCESSOR_CARRY_BIT;
+    gb->processor->a = processor_add(gb->processor, gb->processor->a, add, processor_carry(gb->processor));
 }
 
 #define SUB_A_R(reg)\
 static void sub_a_##reg(GameBoy * const gb) {\
-    uint8_t initial = gb->processor->a;\
-    uint8_t sub = gb->processor->reg;\
-\
-    gb->processor->a -= sub;\
-\
-    gb->processor->f = PROCESSOR_NEGATIVE_BIT;\
-    if ((initial & 0x0F) < (sub & 0x0F)) gb->processor->f |= PROCESSOR_HALF_BIT;\
-    if (gb->processor->a == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;\
-    if (initial < sub) gb->processor->f |= PROCESSOR_CARRY_BIT;\
+    gb->processor->a = processor_sub(gb->processor, gb->processor->a, gb->processor->reg, 0);\
 }
 
 static void sub_a_dhl(GameBoy * const gb) {
-    uint8_t initial = gb->processor->a;
-    uint8_t sub = gameboy_read(gb, gb->processor->hl);
+    uint8_t sub = processor_read(gb, gb->processor->hl);
     gameboy_cycle(gb);
 
-    gb->processor->a -= sub;
-
-    gb->processor->f = PROCESSOR_NEGATIVE_BIT;
-    if ((initial & 0x0F) < (sub & 0x0F)) gb->processor->f |= PROCESSOR_HALF_BIT;
-    if (gb->processor->a == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;
-    if (initial < sub) gb->processor->f |= PROCESSOR_CARRY_BIT;
+    gb->processor->a = processor_sub(gb->processor, gb->processor->a, sub, 0);
 }
 
 static void sub_a_d8(GameBoy * const gb) {
-    uint8_t initial = gb->processor->a;
-    uint8_t sub = gameboy_read(gb, gb->processor->pc);
-    gb->processor->pc += 1;
+    uint8_t sub = processor_fetch(gb);
     gameboy_cycle(gb);
 
-    gb->processor->a -= sub;
-
-    gb->processor->f = PROCESSOR_NEGATIVE_BIT;
-    if ((initial & 0x0F) < (sub & 0x0F)) gb->processor->f |= PROCESSOR_HALF_BIT;
-    if (gb->processor->a == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;
-    if (initial < sub) gb->processor->f |= PROCESSOR_CARRY_BIT;
+    gb->processor->a = processor_sub(gb->processor, gb->processor->a, sub, 0);
 }
 
 #define SBC_A_R(reg)\
 static void sbc_a_##reg(GameBoy * const gb) {\
-    uint8_t initial = gb->processor->a;\
-    uint8_t car = (gb->processor->f & PROCESSOR_CARRY_BIT) != 0;\
-\
-    gb->processor->a = initial - gb->processor->reg - car;\
-\
-    gb->processor->f = PROCESSOR_NEGATIVE_BIT;\
-    if ((initial & 0x0F) < (gb->processor->reg & 0x0F) + car) gb->processor->f |= PROCESSOR_HALF_BIT;\
-    if (gb->processor->a == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;\
-    if (((uint32_t)initial) - gb->processor->reg - car > 0xFF) gb->processor->f |= PROCESSOR_CARRY_BIT;\
+    gb->processor->a = processor_sub(gb->processor, gb->processor->a, gb->processor->reg, processor_carry(gb->processor));\
 }
 
 static void sbc_a_dhl(GameBoy * const gb) {
-    uint8_t initial = gb->processor->a;
-    uint8_t sub = gameboy_read(gb, gb->processor->hl);
-    uint8_t car = (gb->processor->f & PROCESSOR_CARRY_BIT) != 0;
+    uint8_t sub = processor_read(gb, gb->processor->hl);
     gameboy_cycle(gb);
 
-    gb->processor->a = initial - sub - car;
-
-    gb->processor->f = PROCESSOR_NEGATIVE_BIT;
-    if ((initial & 0x0F) < (sub & 0x0F) + car) gb->processor->f |= PROCESSOR_HALF_BIT;
-    if (gb->processor->a == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;
-    if (((uint32_t)initial) - sub - car > 0xFF) gb->processor->f |= PROCESSOR_CARRY_BIT;
+    gb->processor->a = processor_sub(gb->processor, gb->processor->a, sub, processor_carry(gb->processor));
 }
 
 static void sbc_a_d8(GameBoy * const gb) {
-    uint8_t initial = gb->processor->a;
-    uint8_t sub = gameboy_read(gb, gb->processor->pc++);
-    uint8_t car = (gb->processor->f & PROCESSOR_CARRY_BIT) != 0;
+    uint8_t sub = processor_fetch(gb);
     gameboy_cycle(gb);
 
-    gb->processor->a = initial - sub - car;
-
-    gb->processor->f = PROCESSOR_NEGATIVE_BIT;
-    if ((initial & 0x0F) < (sub & 0x0F) + car) gb->processor->f |= PROCESSOR_HALF_BIT;
-    if (gb->processor->a == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;
-    if (((uint32_t)initial) - sub - car > 0xFF) gb->processor->f |= PROCESSOR_CARRY_BIT;
+    gb->processor->a = processor_sub(gb->processor, gb->processor->a, sub, processor_carry(gb->processor));
 }
 
 #define AND_A_R(reg)\
 static void and_a_##reg(GameBoy * const gb) {\
-    gb->processor->a &= gb->processor->reg;\
-\
-    gb->processor->f = PROCESSOR_HALF_BIT;\
-    if (gb->processor->a == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;\
+    gb->processor->a = processor_logic(gb->processor, gb->processor->a & gb->processor->reg, PROCESSOR_HALF_BIT);\
 }
 
 static void and_a_dhl(GameBoy * const gb) {
-    gb->processor->a &= gameboy_read(gb, gb->processor->hl);
+    uint8_t num = processor_read(gb, gb->processor->hl);
     gameboy_cycle(gb);
 
-    gb->processor->f = PROCESSOR_HALF_BIT;
-    if (gb->processor->a == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;
+    gb->processor->a = processor_logic(gb->processor, gb->processor->a & num, PROCESSOR_HALF_BIT);
 }
 
 static void and_a_d8(GameBoy * const gb) {
-    gb->processor->a &= gameboy_read(gb, gb->processor->pc);
-    gb->processor->pc += 1;
+    uint8_t num = processor_fetch(gb);
     gameboy_cycle(gb);
 
-    gb->processor->f = PROCESSOR_HALF_BIT;
-    if (gb->processor->a == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;
+    gb->processor->a = processor_logic(gb->processor, gb->processor->a & num, PROCESSOR_HALF_BIT);
 }
 
 #define XOR_A_R(reg)\
 static void xor_a_##reg(GameBoy * const gb) {\
-    gb->processor->a ^= gb->processor->reg;\
-\
-    gb->processor->f = 0x00;\
-    if (gb->processor->a == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;\
+    gb->processor->a = processor_logic(gb->processor, gb->processor->a ^ gb->processor->reg, 0);\
 }
 
 static void xor_a_dhl(GameBoy * const gb) {
-    gb->processor->a ^= gameboy_read(gb, gb->processor->hl);
+    uint8_t num = processor_read(gb, gb->processor->hl);
     gameboy_cycle(gb);
 
-    gb->processor->f = 0x00;
-    if (gb->processor->a == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;
+    gb->processor->a = processor_logic(gb->processor, gb->processor->a ^ num, 0);
 }
 
 static void xor_a_d8(GameBoy * const gb) {
-    gb->processor->a ^= gameboy_read(gb, gb->processor->pc);
-    gb->processor->pc += 1;
+    uint8_t num = processor_fetch(gb);
     gameboy_cycle(gb);
 
-    gb->processor->f = 0x00;
-    if (gb->processor->a == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;
+    gb->processor->a = processor_logic(gb->processor, gb->processor->a ^ num, 0);
 }
 
 #define OR_A_R(reg)\
 static void or_a_##reg(GameBoy * const gb) {\
-    gb->processor->a |= gb->processor->reg;\
-\
-    gb->processor->f = 0x00;\
-    if (gb->processor->a == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;\
+    gb->processor->a = processor_logic(gb->processor, gb->processor->a | gb->processor->reg, 0);\
 }
 
 static void or_a_dhl(GameBoy * const gb) {
-    gb->processor->a |= gameboy_read(gb, gb->processor->hl);
+    uint8_t num = processor_read(gb, gb->processor->hl);
     gameboy_cycle(gb);
 
-    gb->processor->f = 0x00;
-    if (gb->processor->a == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;
+    gb->processor->a = processor_logic(gb->processor, gb->processor->a | num, 0);
 }
 
 static void or_a_d8(GameBoy * const gb) {
-    gb->processor->a |= gameboy_read(gb, gb->processor->pc);
-    gb->processor->pc += 1;
+    uint8_t num = processor_fetch(gb);
     gameboy_cycle(gb);
 
-    gb->processor->f = 0x00;
-    if (gb->processor->a == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;
+    gb->processor->a = processor_logic(gb->processor, gb->processor->a | num, 0);
 }
 
 #define CP_A_R(reg)\
 static void cp_a_##reg(GameBoy * const gb) {\
-    gb->processor->f = PROCESSOR_NEGATIVE_BIT;\
-\
-    if ((gb->processor->a & 0x0F) < (gb->processor->reg & 0x0F)) gb->processor->f |= PROCESSOR_HALF_BIT;\
-    if (gb->processor->a == gb->processor->reg) gb->processor->f |= PROCESSOR_ZERO_BIT;\
-    if (gb->processor->a < gb->processor->reg) gb->processor->f |= PROCESSOR_CARRY_BIT;\
+    processor_sub(gb->processor, gb->processor->a, gb->processor->reg, 0);\
 }
 
 static void cp_a_dhl(GameBoy * const gb) {
-    uint8_t num = gameboy_read(gb, gb->processor->hl);
+    uint8_t num = processor_read(gb, gb->processor->hl);
     gameboy_cycle(gb);
 
-    gb->processor->f = PROCESSOR_NEGATIVE_BIT;
-    if ((gb->processor->a & 0x0F) < (num & 0x0F)) gb->processor->f |= PROCESSOR_HALF_BIT;
-    if (gb->processor->a == num) gb->processor->f |= PROCESSOR_ZERO_BIT;
-    if (gb->processor->a < num) gb->processor->f |= PROCESSOR_CARRY_BIT;
+    processor_sub(gb->processor, gb->processor->a, num, 0);
 }
 
 static void cp_a_d8(GameBoy * const gb) {
-    uint8_t num = gameboy_read(gb, gb->processor->pc);
-    gb->processor->pc += 1;
+    uint8_t num = processor_fetch(gb);
     gameboy_cycle(gb);
 
-    gb->processor->f = PROCESSOR_NEGATIVE_BIT;
-    if ((gb->processor->a & 0x0F) < (num & 0x0F)) gb->processor->f |= PROCESSOR_HALF_BIT;
-    if (gb->processor->a == num) gb->processor->f |= PROCESSOR_ZERO_BIT;
-    if (gb->processor->a < num) gb->processor->f |= PROCESSOR_CARRY_BIT;
+    processor_sub(gb->processor, gb->processor->a, num, 0);
 }
 
 static void inc_dhl(GameBoy * const gb) {
-    uint8_t num = gameboy_read(gb, gb->processor->hl) + 1;
+    uint8_t num = processor_inc(gb->processor, processor_read(gb, gb->processor->hl));
     gameboy_cycle(gb);
-    gameboy_write(gb, gb->processor->hl, num);
+    processor_write(gb, gb->processor->hl, num);
     gameboy_cycle(gb);
-
-    gb->processor->f &= PROCESSOR_CARRY_BIT;
-    if ((num & 0x0F) == 0) gb->processor->f |= PROCESSOR_HALF_BIT;
-    if (num == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;
 }
 
 static void dec_dhl(GameBoy * const gb) {
-    uint8_t num = gameboy_read(gb, gb->processor->hl) - 1;
+    uint8_t num = processor_dec(gb->processor, processor_read(gb, gb->processor->hl));
     gameboy_cycle(gb);
-    gameboy_write(gb, gb->processor->hl, num);
+    processor_write(gb, gb->processor->hl, num);
     gameboy_cycle(gb);
-
-    gb->processor->f &= PROCESSOR_CARRY_BIT;
-    gb->processor->f |= PROCESSOR_NEGATIVE_BIT;
-    if ((num & 0x0F) == 0x0F) gb->processor->f |= PROCESSOR_HALF_BIT;
-    if (num == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;
 }
 
 #define INC_RR(reg)\
@@ -514,6 +549,7 @@ static void dec_##reg(GameBoy * const gb) {\
 
 #define ADD_HL_RR(reg)\
 static void add_hl_##reg(GameBoy * const gb) {\
+    processor_fold_flags(gb->processor);\
     uint16_t initial = gb->processor->hl;\
     uint16_t add = gb->processor->reg;\
     gameboy_cycle(gb);\
@@ -526,8 +562,9 @@ static void add_hl_##reg(GameBoy * const gb) {\
 }
 
 static void add_sp_r8(GameBoy * const gb) {
+    processor_fold_flags(gb->processor);
     uint16_t initial = gb->processor->sp;
-    int8_t add = gameboy_read(gb, gb->processor->pc++);
+    int8_t add = processor_fetch(gb);
     gameboy_cycle(gb);
     gameboy_cycle(gb);
     gameboy_cycle(gb);
@@ -540,8 +577,9 @@ static void add_sp_r8(GameBoy * const gb) {
 }
 
 static void ld_hl_sp_r8(GameBoy * const gb) {
+    processor_fold_flags(gb->processor);
     uint16_t initial = gb->processor->sp;
-    int8_t add = gameboy_read(gb, gb->processor->pc++);
+    int8_t add = processor_fetch(gb);
     gameboy_cycle(gb);
     gameboy_cycle(gb);
 
@@ -553,9 +591,9 @@ static void ld_hl_sp_r8(GameBoy * const gb) {
 }
 
 static void jp_a16(GameBoy * const gb) {
-    uint16_t val = gameboy_read(gb, gb->processor->pc++);
+    uint16_t val = processor_fetch(gb);
     gameboy_cycle(gb);
-    val |= (gameboy_read(gb, gb->processor->pc++) << 8);
+    val |= (processor_fetch(gb) << 8);
     gameboy_cycle(gb);
     gameboy_cycle(gb);
 
@@ -567,188 +605,188 @@ static void jp_hl(GameBoy * const gb) {
 }
 
 static void jp_nz_a16(GameBoy * const gb) {
-    uint16_t val = gameboy_read(gb, gb->processor->pc++);
+    uint16_t val = processor_fetch(gb);
     gameboy_cycle(gb);
-    val |= (gameboy_read(gb, gb->processor->pc++) << 8);
+    val |= (processor_fetch(gb) << 8);
     gameboy_cycle(gb);
 
-    if ((gb->processor->f & PROCESSOR_ZERO_BIT) == 0) {
+    if (!processor_zero(gb->processor)) {
         gb->processor->pc = val;
         gameboy_cycle(gb);
     }
 }
 
 static void jp_z_a16(GameBoy * const gb) {
-    uint16_t val = gameboy_read(gb, gb->processor->pc++);
+    uint16_t val = processor_fetch(gb);
     gameboy_cycle(gb);
-    val |= (gameboy_read(gb, gb->processor->pc++) << 8);
+    val |= (processor_fetch(gb) << 8);
     gameboy_cycle(gb);
 
-    if ((gb->processor->f & PROCESSOR_ZERO_BIT) != 0) {
+    if (processor_zero(gb->processor)) {
         gb->processor->pc = val;
         gameboy_cycle(gb);
     }
 }
 
 static void jp_nc_a16(GameBoy * const gb) {
-    uint16_t val = gameboy_read(gb, gb->processor->pc++);
+    uint16_t val = processor_fetch(gb);
     gameboy_cycle(gb);
-    val |= (gameboy_read(gb, gb->processor->pc++) << 8);
+    val |= (processor_fetch(gb) << 8);
     gameboy_cycle(gb);
 
-    if ((gb->processor->f & PROCESSOR_CARRY_BIT) == 0) {
+    if (!processor_carry(gb->processor)) {
         gb->processor->pc = val;
         gameboy_cycle(gb);
     }
 }
 
 static void jp_c_a16(GameBoy * const gb) {
-    uint16_t val = gameboy_read(gb, gb->processor->pc++);
+    uint16_t val = processor_fetch(gb);
     gameboy_cycle(gb);
-    val |= (gameboy_read(gb, gb->processor->pc++) << 8);
+    val |= (processor_fetch(gb) << 8);
     gameboy_cycle(gb);
 
-    if ((gb->processor->f & PROCESSOR_CARRY_BIT) != 0) {
+    if (processor_carry(gb->processor)) {
         gb->processor->pc = val;
         gameboy_cycle(gb);
     }
 }
 
 static void jr_r8(GameBoy * const gb) {
-    int8_t jump = gameboy_read(gb, gb->processor->pc++);
+    int8_t jump = processor_fetch(gb);
     gameboy_cycle(gb);
     gb->processor->pc += jump;
     gameboy_cycle(gb);
 }
 
 static void jr_nz_r8(GameBoy * const gb) {
-    int8_t jump = gameboy_read(gb, gb->processor->pc++);
+    int8_t jump = processor_fetch(gb);
     gameboy_cycle(gb);
-    if ((gb->processor->f & PROCESSOR_ZERO_BIT) == 0) {
+    if (!processor_zero(gb->processor)) {
         gb->processor->pc += jump;
         gameboy_cycle(gb);
     }
 }
 
 static void jr_z_r8(GameBoy * const gb) {
-    int8_t jump = gameboy_read(gb, gb->processor->pc++);
+    int8_t jump = processor_fetch(gb);
     gameboy_cycle(gb);
-    if ((gb->processor->f & PROCESSOR_ZERO_BIT) != 0) {
+    if (processor_zero(gb->processor)) {
         gb->processor->pc += jump;
         gameboy_cycle(gb);
     }
 }
 
 static void jr_nc_r8(GameBoy * const gb) {
-    int8_t jump = gameboy_read(gb, gb->processor->pc++);
+    int8_t jump = processor_fetch(gb);
     gameboy_cycle(gb);
-    if ((gb->processor->f & PROCESSOR_CARRY_BIT) == 0) {
+    if (!processor_carry(gb->processor)) {
         gb->processor->pc += jump;
         gameboy_cycle(gb);
     }
 }
 
 static void jr_c_r8(GameBoy * const gb) {
-    int8_t jump = gameboy_read(gb, gb->processor->pc++);
+    int8_t jump = processor_fetch(gb);
     gameboy_cycle(gb);
-    if ((gb->processor->f & PROCESSOR_CARRY_BIT) != 0) {
+    if (processor_carry(gb->processor)) {
         gb->processor->pc += jump;
         gameboy_cycle(gb);
     }
 }
 
 static void call_a16(GameBoy * const gb) {
-    uint16_t val = gameboy_read(gb, gb->processor->pc++);
+    uint16_t val = processor_fetch(gb);
     gameboy_cycle(gb);
-    val |= (gameboy_read(gb, gb->processor->pc++) << 8);
+    val |= (processor_fetch(gb) << 8);
     gameboy_cycle(gb);
     gameboy_cycle(gb); // Delay
-    gameboy_write(gb, --gb->processor->sp, gb->processor->pc >> 8);
+    processor_write(gb, --gb->processor->sp, gb->processor->pc >> 8);
     gameboy_cycle(gb);
-    gameboy_write(gb, --gb->processor->sp, gb->processor->pc & 0xFF);
+    processor_write(gb, --gb->processor->sp, gb->processor->pc & 0xFF);
     gameboy_cycle(gb);
     gb->processor->pc = val;
 }
 
 static void call_nz_a16(GameBoy * const gb) {
-    uint16_t val = gameboy_read(gb, gb->processor->pc++);
+    uint16_t val = processor_fetch(gb);
     gameboy_cycle(gb);
-    val |= (gameboy_read(gb, gb->processor->pc++) << 8);
+    val |= (processor_fetch(gb) << 8);
     gameboy_cycle(gb);
 
-    if ((gb->processor->f & PROCESSOR_ZERO_BIT) == 0) {
+    if (!processor_zero(gb->processor)) {
         gameboy_cycle(gb); // Delay
-        gameboy_write(gb, --gb->processor->sp, gb->processor->pc >> 8);
+        processor_write(gb, --gb->processor->sp, gb->processor->pc >> 8);
         gameboy_cycle(gb);
-        gameboy_write(gb, --gb->processor->sp, gb->processor->pc & 0xFF);
+        processor_write(gb, --gb->processor->sp, gb->processor->pc & 0xFF);
         gameboy_cycle(gb);
         gb->processor->pc = val;
     }
 }
 
 static void call_z_a16(GameBoy * const gb) {
-    uint16_t val = gameboy_read(gb, gb->processor->pc++);
+    uint16_t val = processor_fetch(gb);
     gameboy_cycle(gb);
-    val |= (gameboy_read(gb, gb->processor->pc++) << 8);
+    val |= (processor_fetch(gb) << 8);
     gameboy_cycle(gb);
 
-    if ((gb->processor->f & PROCESSOR_ZERO_BIT) != 0) {
+    if (processor_zero(gb->processor)) {
         gameboy_cycle(gb); // Delay
-        gameboy_write(gb, --gb->processor->sp, gb->processor->pc >> 8);
+        processor_write(gb, --gb->processor->sp, gb->processor->pc >> 8);
         gameboy_cycle(gb);
-        gameboy_write(gb, --gb->processor->sp, gb->processor->pc & 0xFF);
+        processor_write(gb, --gb->processor->sp, gb->processor->pc & 0xFF);
         gameboy_cycle(gb);
         gb->processor->pc = val;
     }
 }
 
 static void call_nc_a16(GameBoy * const gb) {
-    uint16_t val = gameboy_read(gb, gb->processor->pc++);
+    uint16_t val = processor_fetch(gb);
     gameboy_cycle(gb);
-    val |= (gameboy_read(gb, gb->processor->pc++) << 8);
+    val |= (processor_fetch(gb) << 8);
     gameboy_cycle(gb);
 
-    if ((gb->processor->f & PROCESSOR_CARRY_BIT) == 0) {
+    if (!processor_carry(gb->processor)) {
         gameboy_cycle(gb); // Delay
-        gameboy_write(gb, --gb->processor->sp, gb->processor->pc >> 8);
+        processor_write(gb, --gb->processor->sp, gb->processor->pc >> 8);
         gameboy_cycle(gb);
-        gameboy_write(gb, --gb->processor->sp, gb->processor->pc & 0xFF);
+        processor_write(gb, --gb->processor->sp, gb->processor->pc & 0xFF);
         gameboy_cycle(gb);
         gb->processor->pc = val;
     }
 }
 
 static void call_c_a16(GameBoy * const gb) {
-    uint16_t val = gameboy_read(gb, gb->processor->pc++);
+    uint16_t val = processor_fetch(gb);
     gameboy_cycle(gb);
-    val |= (gameboy_read(gb, gb->processor->pc++) << 8);
+    val |= (processor_fetch(gb) << 8);
     gameboy_cycle(gb);
 
-    if ((gb->processor->f & PROCESSOR_CARRY_BIT) != 0) {
+    if (processor_carry(gb->processor)) {
         gameboy_cycle(gb); // Delay
-        gameboy_write(gb, --gb->processor->sp, gb->processor->pc >> 8);
+        processor_write(gb, --gb->processor->sp, gb->processor->pc >> 8);
         gameboy_cycle(gb);
-        gameboy_write(gb, --gb->processor->sp, gb->processor->pc & 0xFF);
+        processor_write(gb, --gb->processor->sp, gb->processor->pc & 0xFF);
         gameboy_cycle(gb);
         gb->processor->pc = val;
     }
 }
 
 static void ret(GameBoy * const gb) {
-    uint16_t val = gameboy_read(gb, gb->processor->sp++);
+    uint16_t val = processor_read(gb, gb->processor->sp++);
     gameboy_cycle(gb);
-    val |= (gameboy_read(gb, gb->processor->sp++) << 8);
+    val |= (processor_read(gb, gb->processor->sp++) << 8);
     gameboy_cycle(gb);
     gb->processor->pc = val;
     gameboy_cycle(gb); // Delay
 }
 
 static void ret_nz(GameBoy * const gb) {
-    if ((gb->processor->f & PROCESSOR_ZERO_BIT) == 0) {
+    if (!processor_zero(gb->processor)) {
         gameboy_cycle(gb); //Delay
-        uint16_t val = gameboy_read(gb, gb->processor->sp++);
+        uint16_t val = processor_read(gb, gb->processor->sp++);
         gameboy_cycle(gb);
-        val |= (gameboy_read(gb, gb->processor->sp++) << 8);
+        val |= (processor_read(gb, gb->processor->sp++) << 8);
         gameboy_cycle(gb);
         gb->processor->pc = val;
     }
@@ -756,11 +794,11 @@ static void ret_nz(GameBoy * const gb) {
 }
 
 static void ret_z(GameBoy * const gb) {
-    if ((gb->processor->f & PROCESSOR_ZERO_BIT) != 0) {
+    if (processor_zero(gb->processor)) {
         gameboy_cycle(gb); //Delay
-        uint16_t val = gameboy_read(gb, gb->processor->sp++);
+        uint16_t val = processor_read(gb, gb->processor->sp++);
         gameboy_cycle(gb);
-        val |= (gameboy_read(gb, gb->processor->sp++) << 8);
+        val |= (processor_read(gb, gb->processor->sp++) << 8);
         gameboy_cycle(gb);
         gb->processor->pc = val;
     }
@@ -768,11 +806,11 @@ static void ret_z(GameBoy * const gb) {
 }
 
 static void ret_nc(GameBoy * const gb) {
-    if ((gb->processor->f & PROCESSOR_CARRY_BIT) == 0) {
+    if (!processor_carry(gb->processor)) {
         gameboy_cycle(gb); //Delay
-        uint16_t val = gameboy_read(gb, gb->processor->sp++);
+        uint16_t val = processor_read(gb, gb->processor->sp++);
         gameboy_cycle(gb);
-        val |= (gameboy_read(gb, gb->processor->sp++) << 8);
+        val |= (processor_read(gb, gb->processor->sp++) << 8);
         gameboy_cycle(gb);
         gb->processor->pc = val;
     }
@@ -780,11 +818,11 @@ static void ret_nc(GameBoy * const gb) {
 }
 
 static void ret_c(GameBoy * const gb) {
-    if ((gb->processor->f & PROCESSOR_CARRY_BIT) != 0) {
+    if (processor_carry(gb->processor)) {
         gameboy_cycle(gb); //Delay
-        uint16_t val = gameboy_read(gb, gb->processor->sp++);
+        uint16_t val = processor_read(gb, gb->processor->sp++);
         gameboy_cycle(gb);
-        val |= (gameboy_read(gb, gb->processor->sp++) << 8);
+        val |= (processor_read(gb, gb->processor->sp++) << 8);
         gameboy_cycle(gb);
         gb->processor->pc = val;
     }
@@ -792,21 +830,21 @@ static void ret_c(GameBoy * const gb) {
 }
 
 static void reti(GameBoy * const gb) {
-    uint16_t val = gameboy_read(gb, gb->processor->sp++);
+    uint16_t val = processor_read(gb, gb->processor->sp++);
     gameboy_cycle(gb);
-    val |= (gameboy_read(gb, gb->processor->sp++) << 8);
+    val |= (processor_read(gb, gb->processor->sp++) << 8);
     gameboy_cycle(gb);
     gb->processor->pc = val;
-    gb->interrupt_controller->ime = true;
+    interrupt_controller_set_ime(gb, true);
     gameboy_cycle(gb); // Delay
 }
 
 #define RST_NNH(value)\
 static void rst_##value##h(GameBoy * const gb) {\
     gameboy_cycle(gb);\
-    gameboy_write(gb, --gb->processor->sp, gb->processor->pc >> 8);\
+    processor_write(gb, --gb->processor->sp, gb->processor->pc >> 8);\
     gameboy_cycle(gb);\
-    gameboy_write(gb, --gb->processor->sp, gb->processor->pc & 0x00FF);\
+    processor_write(gb, --gb->processor->sp, gb->processor->pc & 0x00FF);\
     gameboy_cycle(gb);\
 \
     gb->processor->pc = 0x00##value;\
@@ -814,8 +852,8 @@ static void rst_##value##h(GameBoy * const gb) {\
 
 static void halt(GameBoy * const gb) {
     if (gb->interrupt_controller->ime == 0) {
-        uint8_t interrupt_flags = gameboy_read(gb, INTERRUPT_FLAGS_ADDRESS);
-        uint8_t interrupt_enables = gameboy_read(gb, INTERRUPT_ENABLE_ADDRESS);
+        uint8_t interrupt_flags = processor_read(gb, INTERRUPT_FLAGS_ADDRESS);
+        uint8_t interrupt_enables = processor_read(gb, INTERRUPT_ENABLE_ADDRESS);
         if ((interrupt_flags & interrupt_enables & 0x1F) == 0) gb->processor->skip_next_interrupt = true;
         else {
             gb->processor->skip_pc_increment = true;
@@ -823,6 +861,7 @@ static void halt(GameBoy * const gb) {
         }
     }
     gb->processor->halt_mode = true;
+    gameboy_update_run_state(gb);
 }
 
 static void stop(GameBoy * const gb) {
@@ -830,14 +869,18 @@ static void stop(GameBoy * const gb) {
 }
 
 static void di(GameBoy * const gb) {
-    gb->interrupt_controller->ime = false;
+    interrupt_controller_set_ime(gb, false);
 }
 
 static void ei(GameBoy * const gb) {
-    if (gb->interrupt_controller->ime == false) gb->interrupt_controller->cycles_until_ime = 1;
+    if (gb->interrupt_controller->ime == false) {
+        gb->interrupt_controller->cycles_until_ime = 1;
+        interrupt_controller_update(gb->interrupt_controller);
+    }
 }
 
 static void ccf(GameBoy * const gb) {
+    processor_fold_flags(gb->processor);
     uint8_t zero_bit = gb->processor->f & PROCESSOR_ZERO_BIT;
     gb->processor->f ^= PROCESSOR_CARRY_BIT;
     gb->processor->f &= PROCESSOR_CARRY_BIT;
@@ -845,6 +888,7 @@ static void ccf(GameBoy * const gb) {
 }
 
 static void scf(GameBoy * const gb) {
+    processor_fold_flags(gb->processor);
     gb->processor->f &= PROCESSOR_ZERO_BIT;
     gb->processor->f |= PROCESSOR_CARRY_BIT;
 }
@@ -856,6 +900,7 @@ static void inv_op(GameBoy * const gb) {
 }
 
 static void daa(GameBoy * const gb) {
+    processor_fold_flags(gb->processor);
     if ((gb->processor->f & PROCESSOR_NEGATIVE_BIT) == 0) {
         if ((gb->processor->f & PROCESSOR_CARRY_BIT) != 0 || gb->processor->a > 0x99) {
             gb->processor->a += 0x60;
@@ -874,11 +919,13 @@ static void daa(GameBoy * const gb) {
 }
 
 static void cpl(GameBoy * const gb) {
+    processor_fold_flags(gb->processor);
     gb->processor->a ^= 0xFF;
     gb->processor->f |= PROCESSOR_NEGATIVE_BIT | PROCESSOR_HALF_BIT;
 }
 
 static void rlca(GameBoy * const gb) {
+    processor_fold_flags(gb->processor);
     uint8_t car = (gb->processor->a & 0x80) != 0;
     gb->processor->f = 0;
     gb->processor->a <<= 1;
@@ -889,6 +936,7 @@ static void rlca(GameBoy * const gb) {
 }
 
 static void rrca(GameBoy * const gb) {
+    processor_fold_flags(gb->processor);
     uint8_t car = (gb->processor->a & 0x01) != 0;
     gb->processor->f = 0;
     gb->processor->a >>= 1;
@@ -899,8 +947,9 @@ static void rrca(GameBoy * const gb) {
 }
 
 static void rla(GameBoy * const gb) {
+    processor_fold_flags(gb->processor);
     uint8_t top = (gb->processor->a & 0x80) != 0;
-    uint8_t car = (gb->processor->f & PROCESSOR_CARRY_BIT) != 0;
+    uint8_t car = processor_carry(gb->processor);
     gb->processor->f = 0;
     gb->processor->a <<= 1;
     if (top) gb->processor->f |= PROCESSOR_CARRY_BIT;
@@ -908,8 +957,9 @@ static void rla(GameBoy * const gb) {
 }
 
 static void rra(GameBoy * const gb) {
+    processor_fold_flags(gb->processor);
     uint8_t bot = (gb->processor->a & 0x01) != 0;
-    uint8_t car = (gb->processor->f & PROCESSOR_CARRY_BIT) != 0;
+    uint8_t car = processor_carry(gb->processor);
     gb->processor->f = 0;
     gb->processor->a >>= 1;
     if (bot) gb->processor->f |= PROCESSOR_CARRY_BIT;
@@ -918,6 +968,7 @@ static void rra(GameBoy * const gb) {
 
 #define RLC_R(reg)\
 static void rlc_##reg(GameBoy * const gb) {\
+    processor_fold_flags(gb->processor);\
     uint8_t car = (gb->processor->reg & 0x80) != 0;\
     gb->processor->reg = (gb->processor->reg << 1) | car;\
 \
@@ -927,11 +978,12 @@ static void rlc_##reg(GameBoy * const gb) {\
 }
 
 static void rlc_dhl(GameBoy * const gb) {
-    uint8_t val = gameboy_read(gb, gb->processor->hl);
+    processor_fold_flags(gb->processor);
+    uint8_t val = processor_read(gb, gb->processor->hl);
     gameboy_cycle(gb);
     uint8_t car = (val & 0x80) != 0;
     val = (val << 1) | car;
-    gameboy_write(gb, gb->processor->hl, val);
+    processor_write(gb, gb->processor->hl, val);
     gameboy_cycle(gb);
 
     gb->processor->f = 0;
@@ -941,6 +993,7 @@ static void rlc_dhl(GameBoy * const gb) {
 
 #define RRC_R(reg)\
 static void rrc_##reg(GameBoy * const gb) {\
+    processor_fold_flags(gb->processor);\
     uint8_t car = (gb->processor->reg & 0x01) != 0;\
     gb->processor->reg = (gb->processor->reg >> 1) | (car << 7);\
 \
@@ -950,11 +1003,12 @@ static void rrc_##reg(GameBoy * const gb) {\
 }
 
 static void rrc_dhl(GameBoy * const gb) {
-    uint8_t val = gameboy_read(gb, gb->processor->hl);
+    processor_fold_flags(gb->processor);
+    uint8_t val = processor_read(gb, gb->processor->hl);
     gameboy_cycle(gb);
     uint8_t car = (val & 0x01) != 0;
     val = (val >> 1) | (car << 7);
-    gameboy_write(gb, gb->processor->hl, val);
+    processor_write(gb, gb->processor->hl, val);
     gameboy_cycle(gb);
 
     gb->processor->f = 0;
@@ -964,8 +1018,9 @@ static void rrc_dhl(GameBoy * const gb) {
 
 #define RL_R(reg)\
 static void rl_##reg(GameBoy * const gb) {\
+    processor_fold_flags(gb->processor);\
     uint8_t top = (gb->processor->reg & 0x80) != 0;\
-    uint8_t car = (gb->processor->f & PROCESSOR_CARRY_BIT) != 0;\
+    uint8_t car = processor_carry(gb->processor);\
     gb->processor->reg = (gb->processor->reg << 1) | car;\
 \
     gb->processor->f = 0;\
@@ -974,12 +1029,13 @@ static void rl_##reg(GameBoy * const gb) {\
 }
 
 static void rl_dhl(GameBoy * const gb) {
-    uint8_t val = gameboy_read(gb, gb->processor->hl);
+    processor_fold_flags(gb->processor);
+    uint8_t val = processor_read(gb, gb->processor->hl);
     gameboy_cycle(gb);
     uint8_t top = (val & 0x80) != 0;
-    uint8_t car = (gb->processor->f & PROCESSOR_CARRY_BIT) != 0;
+    uint8_t car = processor_carry(gb->processor);
     val = (val << 1) | car;
-    gameboy_write(gb, gb->processor->hl, val);
+    processor_write(gb, gb->processor->hl, val);
     gameboy_cycle(gb);
 
     gb->processor->f = 0;
@@ -989,8 +1045,9 @@ static void rl_dhl(GameBoy * const gb) {
 
 #define RR_R(reg)\
 static void rr_##reg(GameBoy * const gb) {\
+    processor_fold_flags(gb->processor);\
     uint8_t bot = (gb->processor->reg & 0x01) != 0;\
-    uint8_t car = (gb->processor->f & PROCESSOR_CARRY_BIT) != 0;\
+    uint8_t car = processor_carry(gb->processor);\
     gb->processor->reg = (gb->processor->reg >> 1) | (car << 7);\
 \
     gb->processor->f = 0;\
@@ -999,12 +1056,13 @@ static void rr_##reg(GameBoy * const gb) {\
 }
 
 static void rr_dhl(GameBoy * const gb) {
-    uint8_t val = gameboy_read(gb, gb->processor->hl);
+    processor_fold_flags(gb->processor);
+    uint8_t val = processor_read(gb, gb->processor->hl);
     gameboy_cycle(gb);
     uint8_t bot = (val & 0x01) != 0;
-    uint8_t car = (gb->processor->f & PROCESSOR_CARRY_BIT) != 0;
+    uint8_t car = processor_carry(gb->processor);
     val = (val >> 1) | (car << 7);
-    gameboy_write(gb, gb->processor->hl, val);
+    processor_write(gb, gb->processor->hl, val);
     gameboy_cycle(gb);
 
     gb->processor->f = 0;
@@ -1014,6 +1072,7 @@ static void rr_dhl(GameBoy * const gb) {
 
 #define SLA_R(reg)\
 static void sla_##reg(GameBoy * const gb) {\
+    processor_fold_flags(gb->processor);\
     uint8_t car = (gb->processor->reg & 0x80) != 0;\
     gb->processor->reg <<= 1;\
 \
@@ -1023,12 +1082,13 @@ static void sla_##reg(GameBoy * const gb) {\
 }
 
 static void sla_dhl(GameBoy * const gb) {
-    uint8_t val = gameboy_read(gb, gb->processor->hl);
+    processor_fold_flags(gb->processor);
+    uint8_t val = processor_read(gb, gb->processor->hl);
     gameboy_cycle(gb);
 
     uint8_t car = (val & 0x80) != 0;
     val <<= 1;
-    gameboy_write(gb, gb->processor->hl, val);
+    processor_write(gb, gb->processor->hl, val);
     gameboy_cycle(gb);
 
     gb->processor->f = 0;
@@ -1038,6 +1098,7 @@ static void sla_dhl(GameBoy * const gb) {
 
 #define SRA_R(reg)\
 static void sra_##reg(GameBoy * const gb) {\
+    processor_fold_flags(gb->processor);\
     uint8_t top = gb->processor->reg & 0x80;\
     gb->processor->f = 0;\
     if (gb->processor->reg & 1) gb->processor->f |= PROCESSOR_CARRY_BIT;\
@@ -1046,36 +1107,40 @@ static void sra_##reg(GameBoy * const gb) {\
 }
 
 static void sra_dhl(GameBoy * const gb) {
-    uint8_t val = gameboy_read(gb, gb->processor->hl);
+    processor_fold_flags(gb->processor);
+    uint8_t val = processor_read(gb, gb->processor->hl);
     gameboy_cycle(gb);
     uint8_t top = val & 0x80;
     gb->processor->f = 0;
     if (val & 1) gb->processor->f |= PROCESSOR_CARRY_BIT;
     val = (val >> 1) | top;
-    gameboy_write(gb, gb->processor->hl, val);
+    processor_write(gb, gb->processor->hl, val);
     gameboy_cycle(gb);
     if (val == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;
 }
 
 #define SWAP_R(reg)\
 static void swap_##reg(GameBoy * const gb) {\
+    processor_fold_flags(gb->processor);\
     gb->processor->f = 0;\
     gb->processor->reg = ((gb->processor->reg >> 4) | (gb->processor->reg << 4));\
     if (gb->processor->reg == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;\
 }
 
 static void swap_dhl(GameBoy * const gb) {
-    uint8_t val = gameboy_read(gb, gb->processor->hl);
+    processor_fold_flags(gb->processor);
+    uint8_t val = processor_read(gb, gb->processor->hl);
     gameboy_cycle(gb);
     gb->processor->f = 0;
     val = ((val >> 4) | (val << 4));
-    gameboy_write(gb, gb->processor->hl, val);
+    processor_write(gb, gb->processor->hl, val);
     gameboy_cycle(gb);
     if (val == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;
 }
 
 #define SRL_R(reg)\
 static void srl_##reg(GameBoy * const gb) {\
+    processor_fold_flags(gb->processor);\
     gb->processor->f = 0;\
     if (gb->processor->reg & 1) gb->processor->f |= PROCESSOR_CARRY_BIT;\
     gb->processor->reg >>= 1;\
@@ -1083,18 +1148,20 @@ static void srl_##reg(GameBoy * const gb) {\
 }
 
 static void srl_dhl(GameBoy * const gb) {
-    uint8_t val = gameboy_read(gb, gb->processor->hl);
+    processor_fold_flags(gb->processor);
+    uint8_t val = processor_read(gb, gb->processor->hl);
     gameboy_cycle(gb);
     gb->processor->f = 0;
     if (val & 1) gb->processor->f |= PROCESSOR_CARRY_BIT;
     val >>= 1;
-    gameboy_write(gb, gb->processor->hl, val);
+    processor_write(gb, gb->processor->hl, val);
     gameboy_cycle(gb);
     if (val == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;
 }
 
 #define BIT_N_R(num, reg)\
 static void bit_##num##_##reg(GameBoy * const gb) {\
+    processor_fold_flags(gb->processor);\
     gb->processor->f &= PROCESSOR_CARRY_BIT;\
     gb->processor->f |= PROCESSOR_HALF_BIT;\
     if (((1 << num) & gb->processor->reg) == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;\
@@ -1102,9 +1169,10 @@ static void bit_##num##_##reg(GameBoy * const gb) {\
 
 #define BIT_N_DHL(num)\
 static void bit_##num##_dhl(GameBoy * const gb) {\
+    processor_fold_flags(gb->processor);\
     gb->processor->f &= PROCESSOR_CARRY_BIT;\
     gb->processor->f |= PROCESSOR_HALF_BIT;\
-    if (((1 << num) & gameboy_read(gb, gb->processor->hl)) == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;\
+    if (((1 << num) & processor_read(gb, gb->processor->hl)) == 0) gb->processor->f |= PROCESSOR_ZERO_BIT;\
     gameboy_cycle(gb);\
 }
 
@@ -1115,9 +1183,9 @@ static void res_##num##_##reg(GameBoy * const gb) {\
 
 #define RES_N_DHL(num)\
 static void res_##num##_dhl(GameBoy * const gb) {\
-    uint8_t mask = gameboy_read(gb, gb->processor->hl) & ~(1 << num);\
+    uint8_t mask = processor_read(gb, gb->processor->hl) & ~(1 << num);\
     gameboy_cycle(gb);\
-    gameboy_write(gb, gb->processor->hl, mask);\
+    processor_write(gb, gb->processor->hl, mask);\
     gameboy_cycle(gb);\
 }
 
@@ -1128,9 +1196,9 @@ static void set_##num##_##reg(GameBoy * const gb) {\
 
 #define SET_N_DHL(num)\
 static void set_##num##_dhl(GameBoy * const gb) {\
-    uint8_t mask = gameboy_read(gb, gb->processor->hl) | (1 << num);\
+    uint8_t mask = processor_read(gb, gb->processor->hl) | (1 << num);\
     gameboy_cycle(gb);\
-    gameboy_write(gb, gb->processor->hl, mask);\
+    processor_write(gb, gb->processor->hl, mask);\
     gameboy_cycle(gb);\
 }
 
@@ -1169,7 +1237,7 @@ SET_N_R(5, b) SET_N_R(5, c) SET_N_R(5, d) SET_N_R(5, e) SET_N_R(5, h) SET_N_R(5,
 SET_N_R(6, b) SET_N_R(6, c) SET_N_R(6, d) SET_N_R(6, e) SET_N_R(6, h) SET_N_R(6, l) SET_N_DHL(6) SET_N_R(6, a) /*F*/
 SET_N_R(7, b) SET_N_R(7, c) SET_N_R(7, d) SET_N_R(7, e) SET_N_R(7, h) SET_N_R(7, l) SET_N_DHL(7) SET_N_R(7, a)
 
-static void (*prefixed_instructions[])(GameBoy * const gb) = {
+static void (* const prefixed_instructions[])(GameBoy * const gb) = {
     /*0*/    /*1*/    /*2*/    /*3*/    /*4*/    /*5*/    /*6*/      /*7*/
     /*8*/    /*9*/    /*A*/    /*B*/    /*C*/    /*D*/    /*E*/      /*F*/
     rlc_b,   rlc_c,   rlc_d,   rlc_e,   rlc_h,   rlc_l,   rlc_dhl,   rlc_a,   /*0*/
@@ -1207,7 +1275,7 @@ static void (*prefixed_instructions[])(GameBoy * const gb) = {
 };
 
 static void prefix_cb(GameBoy * const gb) {
-    uint8_t opcode = gameboy_read(gb, gb->processor->pc++);
+    uint8_t opcode = processor_fetch(gb);
     gameboy_cycle(gb);
     prefixed_instructions[opcode](gb);
 }
@@ -1219,6 +1287,12 @@ RST_NNH(50)
 RST_NNH(58)
 RST_NNH(60)
 
+// Interrupt vectors by priority, indexed by the lowest set bit of the pending interrupts
+static void (* const interrupt_vectors[])(GameBoy * const gb) = { rst_40h, rst_48h, rst_50h, rst_58h, rst_60h };
+static uint8_t const interrupt_priorities[32] = {
+    0, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+};
+
 /*0*/          /*1*/         /*2*/         /*3*/         /*4*/           /*5*/        /*6*/         /*7*/
 /*8*/          /*9*/         /*A*/         /*B*/         /*C*/           /*D*/        /*E*/         /*F*/
 /*NOP*/        LD_RR_D16(bc) LD_DRR_A(bc)  INC_RR(bc)    INC_R(b)        DEC_R(b)     LD_R_D8(b)    /*RLCA*/     /*0*/
@@ -1251,10 +1325,10 @@ CP_A_R(b)      CP_A_R(c)     CP_A_R(d)     CP_A_R(e)     CP_A_R(h)       CP_A_R(
 /*RET_C*/      /*RETI*/      /*JP_C_A16*/  /*INVOP*/     /*CALL_C_A16*/  /*INVOP*/    /*SBC_A_D8*/  RST_NNH(18)
 /*LDH_DA8_A*/  POP_RR(hl)    /*LD_DC_A*/   /*INVOP*/     /*INVOP*/       PUSH_RR(hl)  /*AND_A_D8*/  RST_NNH(20)  /*E*/
 /*ADD_SP_R8*/  /*JP_DHL*/    /*LD_DA16_A*/ /*INVOP*/     /*INVOP*/       /*INVOP*/    /*XOR_A_D8*/  RST_NNH(28)
-/*LDH_A_DA8*/  /*POP_AF*/    /*LD_A_DC*/   /*DI*/        /*INVOP*/       PUSH_RR(af)  /*OR_A_D8*/   RST_NNH(30)  /*F*/
+/*LDH_A_DA8*/  /*POP_AF*/    /*LD_A_DC*/   /*DI*/        /*INVOP*/       /*PUSH_AF*/  /*OR_A_D8*/   RST_NNH(30)  /*F*/
 /*LD_HL_SPR8*/ /*LD_SP_HL*/  /*LD_A_DA16*/ /*EI*/        /*INVOP*/       /*INVOP*/    /*CP_A_D8*/   RST_NNH(38)
 
-static void (*instructions[])(GameBoy * const gb) = {
+static void (* const instructions[])(GameBoy * const gb) = {
     /*0*/        /*1*/      /*2*/          /*3*/      /*4*/        /*5*/     /*6*/      /*7*/
     /*8*/        /*9*/      /*A*/          /*B*/      /*C*/        /*D*/     /*E*/      /*F*/
     nop,         ld_bc_d16, ld_dbc_a,      inc_bc,    inc_b,       dec_b,    ld_b_d8,   rlca,     /*0*/
@@ -1291,60 +1365,1109 @@ static void (*instructions[])(GameBoy * const gb) = {
     ld_hl_sp_r8, ld_sp_hl,  ld_a_da16,     ei,        inv_op,      inv_op,   cp_a_d8,   rst_38h
 };
 
+// Operand bytes following each opcode, as consumed by the handlers above
+static uint8_t const operand_lengths[] = {
+    /*0*/ /*1*/ /*2*/ /*3*/ /*4*/ /*5*/ /*6*/ /*7*/ /*8*/ /*9*/ /*A*/ /*B*/ /*C*/ /*D*/ /*E*/ /*F*/
+    0,    2,    0,    0,    0,    0,    1,    0,    2,    0,    0,    0,    0,    0,    1,    0,    /*0*/
+    0,    2,    0,    0,    0,    0,    1,    0,    1,    0,    0,    0,    0,    0,    1,    0,    /*1*/
+    1,    2,    0,    0,    0,    0,    1,    0,    1,    0,    0,    0,    0,    0,    1,    0,    /*2*/
+    1,    2,    0,    0,    0,    0,    1,    0,    1,    0,    0,    0,    0,    0,    1,    0,    /*3*/
+    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    /*4*/
+    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    /*5*/
+    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    /*6*/
+    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    /*7*/
+    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    /*8*/
+    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    /*9*/
+    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    /*A*/
+    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    /*B*/
+    0,    0,    2,    2,    2,    0,    1,    0,    0,    0,    2,    1,    2,    2,    1,    0,    /*C*/
+    0,    0,    2,    0,    2,    0,    1,    0,    0,    0,    2,    0,    2,    0,    1,    0,    /*D*/
+    1,    0,    0,    0,    0,    0,    1,    0,    1,    0,    2,    0,    0,    0,    1,    0,    /*E*/
+    1,    0,    0,    0,    0,    0,    1,    0,    1,    0,    2,    0,    0,    0,    1,    0     /*F*/
+};
+
+// Jumps, calls, returns, restarts, HALT, STOP and invalid opcodes end a block
+static bool processor_ends_block(uint8_t opcode) {
+    switch (opcode) {
+        case 0x10: case 0x18: case 0x20: case 0x28: case 0x30: case 0x38: case 0x76:
+        case 0xC0: case 0xC2: case 0xC3: case 0xC4: case 0xC7: case 0xC8: case 0xC9: case 0xCA: case 0xCC: case 0xCD: case 0xCF:
+        case 0xD0: case 0xD2: case 0xD3: case 0xD4: case 0xD7: case 0xD8: case 0xD9: case 0xDA: case 0xDB: case 0xDC: case 0xDD: case 0xDF:
+        case 0xE3: case 0xE4: case 0xE7: case 0xE9: case 0xEB: case 0xEC: case 0xED: case 0xEF:
+        case 0xF4: case 0xF7: case 0xFC: case 0xFD: case 0xFF:
+            return true;
+    }
+    return false;
+}
+
+// Returns the host byte behind a code address if it can only change through a write we see:
+// ROM, the boot ROM, WRAM and HRAM. Everything else, including ROM during OAM DMA, is interpreted.
+static uint8_t const * processor_get_code(GameBoy * const gb, uint16_t address) {
+    uint8_t page = address >> 8;
+    if (page < 0x80 || (page >= 0xC0 && page < 0xFE)) {
+        uint8_t const * data = gb->read_pages[page];
+        return data != NULL ? data + (address & 0xFF) : NULL;
+    }
+    if (address >= 0xFF80 && address < 0xFFFF) return &gb->processor->hram[address - 0xFF80];
+    return NULL;
+}
+
+// WRAM and HRAM share one code map, HRAM sits right after the 8KiB of WRAM
+static size_t processor_get_code_map_index(GameBoy const * const gb, uint8_t const * code) {
+    if (code >= gb->processor->ram && code < gb->processor->ram + sizeof(gb->processor->ram)) return code - gb->processor->ram;
+    if (code >= gb->processor->hram && code < gb->processor->hram + sizeof(gb->processor->hram)) return sizeof(gb->processor->ram) + (code - gb->processor->hram);
+    return SIZE_MAX;
+}
+
+#define PROCESSOR_IDLE_F      (1 << 6) // Registers as bits of their r field, F takes the (HL) slot
+#define PROCESSOR_IDLE_A      (1 << 7)
+#define PROCESSOR_IDLE_POINTS_BC (0b0001)
+#define PROCESSOR_IDLE_POINTS_DE (0b0010)
+#define PROCESSOR_IDLE_POINTS_HL (0b0100)
+#define PROCESSOR_IDLE_POINTS_C  (0b1000) // LD A,(C) reads 0xFF00 + C
+
+static uint8_t processor_get_register_bits(uint8_t r) {
+    return r == 6 ? (1 << 4) | (1 << 5) : 1 << r;
+}
+
+// Whether a read can change between scheduler events without the CPU writing anything, as DIV does
+// every cycle. P1 only moves with the input, and IF, STAT and LY with events, so loops polling
+// them are skipped through like any other idle loop.
+static bool processor_is_unstable(uint16_t address) {
+    if (address < 0xFF00 || (address >= 0xFF80 && address < 0xFFFF)) return false;
+    return address != 0xFF00 && address != 0xFF0F && address != 0xFF41 && address != 0xFF44;
+}
+
+// Returns the M-cycles of one pass if the block is a loop back to its first op whose passes only
+// read memory into registers they don't read first, so every pass with the same memory leaves the
+// same state. Returns 0 for any other block.
+static size_t processor_get_idle_cycles(ProcessorBlock * const block) {
+    ProcessorOp const * const last = &block->ops[block->length - 1];
+    uint16_t target;
+    uint8_t branch_reads = 0;
+    size_t cycles;
+    switch (last->opcode) {
+        case 0x20: case 0x28: case 0x30: case 0x38: branch_reads = PROCESSOR_IDLE_F; // fallthrough
+        case 0x18: target = last->address + 2 + (int8_t)last->operands[0]; cycles = 3; break;
+        case 0xC2: case 0xCA: case 0xD2: case 0xDA: branch_reads = PROCESSOR_IDLE_F; // fallthrough
+        case 0xC3: target = last->operands[0] | last->operands[1] << 8; cycles = 4; break;
+        default: return 0;
+    }
+    if (target != block->ops[0].address) return 0;
+
+    uint8_t written = 0;
+    uint8_t read_first = 0;
+    block->idle_pointers = 0;
+    for (size_t i = 0; i + 1 < block->length; i++) {
+        ProcessorOp const * const op = &block->ops[i];
+        uint8_t opcode = op->opcode;
+        uint8_t reads = 0;
+        uint8_t writes = 0;
+        uint8_t src = opcode & 0x07;
+        uint8_t alu = (opcode >> 3) & 0x07;
+
+        if (opcode == 0x00) cycles += 1;
+        else if ((opcode & 0xC7) == 0x06 && alu != 6) {
+            writes = 1 << alu;
+            cycles += 2;
+        }
+        else if (opcode == 0x0A || opcode == 0x1A) {
+            reads = processor_get_register_bits(opcode == 0x0A ? 0 : 2) | processor_get_register_bits(opcode == 0x0A ? 1 : 3);
+            writes = PROCESSOR_IDLE_A;
+            block->idle_pointers |= opcode == 0x0A ? PROCESSOR_IDLE_POINTS_BC : PROCESSOR_IDLE_POINTS_DE;
+            cycles += 2;
+        }
+        else if (opcode == 0xFA && !processor_is_unstable(op->operands[0] | op->operands[1] << 8)) {
+            writes = PROCESSOR_IDLE_A;
+            cycles += 4;
+        }
+        else if (opcode == 0xF0 && !processor_is_unstable(0xFF00 | op->operands[0])) {
+            writes = PROCESSOR_IDLE_A;
+            cycles += 3;
+        }
+        else if (opcode == 0xF2) {
+            reads = processor_get_register_bits(1);
+            writes = PROCESSOR_IDLE_A;
+            block->idle_pointers |= PROCESSOR_IDLE_POINTS_C;
+            cycles += 2;
+        }
+        else if (opcode >= 0x40 && opcode < 0x80 && alu != 6) {
+            reads = processor_get_register_bits(src);
+            writes = 1 << alu;
+            cycles += src == 6 ? 2 : 1;
+        }
+        else if ((opcode >= 0x80 && opcode < 0xC0) || (opcode & 0xC7) == 0xC6) {
+            bool immediate = opcode >= 0xC0;
+            reads = PROCESSOR_IDLE_A | (immediate ? 0 : processor_get_register_bits(src));
+            if (alu == 1 || alu == 3) reads |= PROCESSOR_IDLE_F; // ADC and SBC
+            writes = PROCESSOR_IDLE_F | (alu == 7 ? 0 : PROCESSOR_IDLE_A);
+            cycles += immediate || src == 6 ? 2 : 1;
+        }
+        else if (op->prefixed && op->operands[0] >= 0x40 && op->operands[0] < 0x80) { // BIT
+            src = op->operands[0] & 0x07;
+            reads = processor_get_register_bits(src);
+            writes = PROCESSOR_IDLE_F;
+            cycles += src == 6 ? 3 : 2;
+        }
+        else return 0;
+
+        if ((opcode & 0x07) == 6 && opcode >= 0x40 && opcode < 0xC0) block->idle_pointers |= PROCESSOR_IDLE_POINTS_HL;
+        if (op->prefixed && src == 6) block->idle_pointers |= PROCESSOR_IDLE_POINTS_HL;
+        read_first |= reads & ~written;
+        written |= writes;
+    }
+    read_first |= branch_reads & ~written;
+
+    return (read_first & written) == 0 ? cycles : 0;
+}
+
+#define PROCESSOR_COPY_FROM_HL  (0b000001) // LD A,(HL+); LD (DE),A; INC DE
+#define PROCESSOR_COPY_FROM_DE  (0b000010) // LD A,(DE); LD (HL+),A; INC DE
+#define PROCESSOR_COPY_DOWN     (0b000100) // LD (HL-),A
+#define PROCESSOR_COPY_COUNT_B  (0b001000) // DEC B
+#define PROCESSOR_COPY_COUNT_C  (0b010000) // DEC C
+#define PROCESSOR_COPY_COUNT_BC (0b100000) // DEC BC; LD A,B; OR C
+
+// Recognizes the loops games copy and clear memory with, one byte a pass until a counter runs out:
+// a copy or a LD (HL+),A / LD (HL-),A fill, then DEC B, DEC C or DEC BC with an OR of B and C, then a
+// JR NZ back to the start. Fills counting with BC reload A first with LD A,d8 or XOR A.
+static void processor_get_copy_loop(ProcessorBlock * const block) {
+    static struct { uint8_t length; uint8_t opcodes[3]; uint8_t shape; uint8_t cycles; } const transfers[] = {
+        { 3, { 0x2A, 0x12, 0x13 }, PROCESSOR_COPY_FROM_HL, 6 },
+        { 3, { 0x1A, 0x22, 0x13 }, PROCESSOR_COPY_FROM_DE, 6 },
+        { 1, { 0x22 }, 0, 2 },
+        { 1, { 0x32 }, PROCESSOR_COPY_DOWN, 2 },
+    };
+    size_t const transfer_count = sizeof(transfers) / sizeof(transfers[0]);
+
+    block->copy_cycles = 0;
+    block->copy_shape = 0;
+
+    size_t i = 0;
+    uint8_t cycles = 3;
+    bool reload = block->ops[0].opcode == 0x3E || block->ops[0].opcode == 0xAF;
+    if (reload) cycles += block->ops[i++].opcode == 0x3E ? 2 : 1;
+
+    size_t transfer = 0;
+    for (; transfer < transfer_count; transfer++) {
+        if (i + transfers[transfer].length >= block->length) continue;
+
+        size_t j = 0;
+        while (j < transfers[transfer].length && block->ops[i + j].opcode == transfers[transfer].opcodes[j]) j++;
+        if (j == transfers[transfer].length) break;
+    }
+    if (transfer == transfer_count) return;
+    bool copy = transfers[transfer].length == 3;
+    if (reload && copy) return;
+    i += transfers[transfer].length;
+    cycles += transfers[transfer].cycles;
+
+    uint8_t shape = transfers[transfer].shape;
+    ProcessorOp const * const ops = &block->ops[i];
+    if (i + 2 == block->length && (ops[0].opcode == 0x05 || ops[0].opcode == 0x0D) && !reload) {
+        shape |= ops[0].opcode == 0x05 ? PROCESSOR_COPY_COUNT_B : PROCESSOR_COPY_COUNT_C;
+        cycles += 1;
+    }
+    else if (i + 4 == block->length && ops[0].opcode == 0x0B
+        && ((ops[1].opcode == 0x78 && ops[2].opcode == 0xB1) || (ops[1].opcode == 0x79 && ops[2].opcode == 0xB0))) {
+        shape |= PROCESSOR_COPY_COUNT_BC;
+        cycles += 4;
+    }
+    else return;
+    // Without a reload, A ends each pass holding B | C and the fill would change value
+    if (!copy && (shape & PROCESSOR_COPY_COUNT_BC) && !reload) return;
+
+    ProcessorOp const * const last = &block->ops[block->length - 1];
+    if (last->opcode != 0x20 || (uint16_t)(last->address + 2 + (int8_t)last->operands[0]) != block->ops[0].address) return;
+
+    block->copy_cycles = cycles;
+    block->copy_shape = shape;
+}
+
+// Whether the next instruction needs the full checks in processor_process_instruction:
+// HALT, the HALT bug, an EI delay, a DMA request or an interrupt about to be serviced
+static inline bool processor_is_pending(GameBoy const * const gb) {
+    if (gb->processor->halt_mode || gb->processor->skip_pc_increment || gb->processor->skip_next_interrupt) return true;
+    return gb->interrupt_controller->pending != 0 || gb->dma->queue != -1;
+}
+
+// Pairs of unprefixed ops run as one handler, the most frequent ones trtle_pairs found across the
+// test ROMs. Regenerate with make pairs && ./trtle_pairs game.gb...
+#define PROCESSOR_FUSED_PAIRS(X)\
+    X(0D, 20) X(05, 20) X(B1, 20) X(78, B1) X(0B, 78) X(12, 13) X(2A, 12) X(13, 0B)\
+    X(F0, FE) X(FE, 28) X(22, 0D) X(3C, 0D) X(22, 3C) X(A7, 28) X(FA, A7) X(2F, 37)
+
+// Fetches the second op of a fused pair as processor_process_instruction would. It refuses once an
+// event has fired, so the update ends on the op the event happened in, or when the first op left
+// the block or needs the full checks. Instruction timing charges the first op before the check.
+static inline bool processor_fetch_fused(GameBoy * const gb, ProcessorOp const * const op, uint64_t next) {
+    ProcessorBlock const * const block = gb->processor->block;
+    if (block == NULL || gb->processor->block_index >= block->length || &block->ops[gb->processor->block_index] != op) return false;
+    if (gb->scheduler->owed != 0) scheduler_charge(gb);
+    if (gb->scheduler->next != next || processor_is_pending(gb) || op->address != gb->processor->pc) return false;
+
+    gb->processor->block_index += 1;
+    gb->processor->operands = op->operands;
+    gb->processor->pc += 1;
+    gameboy_cycle(gb);
+    return true;
+}
+
+#ifndef TRTLE_PAIR_PROFILE
+#define PROCESSOR_FUSED_HANDLER(first, second)\
+static void fused_##first##_##second(GameBoy * const gb, ProcessorOp const * const op, uint64_t next) {\
+    instructions[0x##first](gb);\
+    if (!processor_fetch_fused(gb, op + 1, next)) return;\
+    instructions[0x##second](gb);\
+}
+PROCESSOR_FUSED_PAIRS(PROCESSOR_FUSED_HANDLER)
+
+#define PROCESSOR_FUSED_CASE(first, second) case 0x##first##second: return fused_##first##_##second;
+
+static void (*processor_get_fused(uint8_t first, uint8_t second))(GameBoy * const, ProcessorOp const * const, uint64_t) {
+    switch (first << 8 | second) {
+        PROCESSOR_FUSED_PAIRS(PROCESSOR_FUSED_CASE)
+    }
+    return NULL;
+}
+#endif
+
+static void processor_decode_block(GameBoy * const gb, ProcessorBlock * const block, uint8_t const * code, uint16_t address) {
+    bool remap = false;
+
+    // Both the opcodes and their operands have to sit in the starting page, HRAM also stops short of IE
+    size_t remaining = address >= 0xFF80 ? 0xFFFF - address : 0x100 - (address & 0xFF);
+
+    block->code = code;
+    block->length = 0;
+    while (block->length < PROCESSOR_BLOCK_LENGTH && remaining > 0) {
+        uint8_t opcode = code[0];
+        size_t size = 1 + operand_lengths[opcode];
+        if (size > remaining) break;
+        remaining -= size;
+
+        ProcessorOp * const op = &block->ops[block->length++];
+        op->address = address;
+        op->opcode = opcode;
+        op->length = size;
+        op->operands[0] = size > 1 ? code[1] : 0;
+        op->operands[1] = size > 2 ? code[2] : 0;
+        op->prefixed = opcode == 0xCB;
+        op->execute = op->prefixed ? prefixed_instructions[op->operands[0]] : instructions[opcode];
+        op->fused = NULL;
+        op->native = NULL;
+        op->native_compiled = false;
+#ifndef TRTLE_PAIR_PROFILE
+        if (block->length > 1 && !op->prefixed && !op[-1].prefixed) op[-1].fused = processor_get_fused(op[-1].opcode, opcode);
+#endif
+
+        size_t index = processor_get_code_map_index(gb, code);
+        if (index != SIZE_MAX) {
+            if (index >= sizeof(gb->processor->ram) && !gb->processor->code_map[index]) remap = true;
+            for (size_t i = 0; i < size; i++) gb->processor->code_map[index + i] = true;
+            if (index < sizeof(gb->processor->ram) && !gb->processor->ram_code_pages[index >> 8]) {
+                gb->processor->ram_code_pages[index >> 8] = true;
+                remap = true;
+            }
+        }
+
+        code += size;
+        address += size;
+        if (processor_ends_block(opcode)) break;
+    }
+    block->end = code;
+    block->idle_cycles = block->length > 0 ? processor_get_idle_cycles(block) : 0;
+    processor_get_copy_loop(block);
+
+    // WRAM pages and HRAM bytes holding code lose their direct write pointer so rewrites reach
+    // processor_invalidate_code
+    if (remap) gameboy_remap(gb);
+}
+
+static ProcessorBlock * processor_get_block(GameBoy * const gb, uint8_t const * code, uint16_t address) {
+    uintptr_t hash = ((uintptr_t)code * 0x9E3779B1u) >> 7;
+    ProcessorBlock * const block = &gb->processor->blocks[hash % PROCESSOR_BLOCK_COUNT];
+    if (block->code != code || block->length == 0 || block->ops[0].address != address) processor_decode_block(gb, block, code, address);
+    return block;
+}
+
+// Returns the block holding the op at PC and that op's index, decoding a new block if needed
+ProcessorBlock * processor_get_current_block(GameBoy * const gb, size_t * const index) {
+    if (gb->dma->queue != -1) return NULL;
+
+    ProcessorBlock * block = gb->processor->block;
+    if (block != NULL && gb->processor->block_index < block->length && block->ops[gb->processor->block_index].address == gb->processor->pc) {
+        *index = gb->processor->block_index;
+        return block;
+    }
+
+    uint8_t const * code = processor_get_code(gb, gb->processor->pc);
+    if (code == NULL) return NULL;
+
+    block = processor_get_block(gb, code, gb->processor->pc);
+    *index = 0;
+    return block->length > 0 ? block : NULL;
+}
+
+// Continues interpreting a block from one of its ops
+void processor_resume_block(GameBoy * const gb, ProcessorBlock * const block, size_t index) {
+    gb->processor->block = block;
+    gb->processor->block_index = index;
+}
+
+void processor_flush_blocks(GameBoy * const gb) {
+    for (size_t i = 0; i < PROCESSOR_BLOCK_COUNT; i++) {
+        gb->processor->blocks[i].code = NULL;
+        gb->processor->blocks[i].length = 0;
+    }
+    gb->processor->block = NULL;
+    gb->processor->idle_block = NULL;
+}
+
+void processor_invalidate_code(GameBoy * const gb, uint16_t address) {
+    uint8_t const * code = processor_get_code(gb, address);
+    if (code == NULL) return;
+
+    size_t index = processor_get_code_map_index(gb, code);
+    if (index == SIZE_MAX || !gb->processor->code_map[index]) return;
+
+    gb->processor->code_map[index] = false;
+    for (size_t i = 0; i < PROCESSOR_BLOCK_COUNT; i++) {
+        ProcessorBlock * const block = &gb->processor->blocks[i];
+        if (block->length == 0) continue;
+        if ((uintptr_t)code < (uintptr_t)block->code || (uintptr_t)code >= (uintptr_t)block->end) continue;
+
+        // Other bytes of the block stay marked and will be marked again when it is decoded
+        block->code = NULL;
+        block->length = 0;
+    }
+}
+
+// Finds the decoded instruction at PC, continuing through the current block when possible.
+// Remapping memory drops the current block, so following it needs no bus lookup.
+static ProcessorOp const * processor_get_op(GameBoy * const gb) {
+    // A pending OAM DMA can start mid-instruction and make the remaining operand fetches conflict
+    if (gb->dma->queue != -1) return NULL;
+
+    ProcessorBlock * block = gb->processor->block;
+    if (block != NULL && gb->processor->block_index < block->length && block->ops[gb->processor->block_index].address == gb->processor->pc) {
+        return &block->ops[gb->processor->block_index++];
+    }
+
+    uint8_t const * code = processor_get_code(gb, gb->processor->pc);
+    if (code == NULL) {
+        gb->processor->block = NULL;
+        return NULL;
+    }
+
+    block = processor_get_block(gb, code, gb->processor->pc);
+    if (block->length == 0) {
+        gb->processor->block = NULL;
+        return NULL;
+    }
+
+    gb->processor->block = block;
+    gb->processor->block_index = 1;
+    return &block->ops[0];
+}
+
+// Called after the last op of an idle loop. Once a whole pass has run without an event firing, the
+// next passes read the same memory and leave the same state, so they are skipped up to the cycle
+// before the next event. That event then fires at the same point of a pass as it would have.
+static void processor_check_idle(GameBoy * const gb, ProcessorBlock * const block) {
+    Processor * const p = gb->processor;
+    scheduler_charge(gb); // Instruction timing still owes the last op of the pass
+    uint64_t const next = gb->scheduler->next;
+
+    if (p->pc != block->ops[0].address || processor_is_pending(gb)) {
+        p->idle_block = NULL;
+        return;
+    }
+
+    bool unstable = ((block->idle_pointers & PROCESSOR_IDLE_POINTS_BC) && processor_is_unstable(p->bc))
+        || ((block->idle_pointers & PROCESSOR_IDLE_POINTS_DE) && processor_is_unstable(p->de))
+        || ((block->idle_pointers & PROCESSOR_IDLE_POINTS_HL) && processor_is_unstable(p->hl))
+        || ((block->idle_pointers & PROCESSOR_IDLE_POINTS_C) && processor_is_unstable(0xFF00 | p->c));
+    if (p->idle_block == block && p->idle_next == next && next != SCHEDULER_NEVER && !unstable
+        && gb->scheduler->clock - p->idle_clock == block->idle_cycles) {
+        uint64_t passes = (next - 1 - gb->scheduler->clock) / block->idle_cycles;
+        gb->scheduler->clock += passes * block->idle_cycles;
+    }
+
+    p->idle_block = block;
+    p->idle_clock = gb->scheduler->clock;
+    p->idle_next = next;
+}
+
+// Reads and writes a bulk copy may make without stepping, IO registers could schedule events or
+// change between passes and writes below VRAM could switch banks
+static bool processor_is_bulk_readable(uint16_t address) {
+    return address < 0xFF00 || (address >= 0xFF80 && address < 0xFFFF);
+}
+
+static bool processor_is_bulk_writable(uint16_t address) {
+    return (address >= 0x8000 && address < 0xFEA0) || (address >= 0xFF80 && address < 0xFFFF);
+}
+
+// Called after the last op of a copy or fill loop. The passes that fit before the next event and
+// keep the branch taken run here in a row, each access at the cycle stepping would make it on, so
+// the registers, flags and clock end up as if every op had been interpreted. A pass that would
+// touch IO or ROM, or OAM DMA running, hands the loop back to the interpreter. An event that fired
+// since next was read has to end the update first, as in processor_run_threaded.
+static void processor_run_copy(GameBoy * const gb, ProcessorBlock * const block, uint64_t next) {
+    Processor * const p = gb->processor;
+    uint8_t const shape = block->copy_shape;
+    uint8_t const cycles = block->copy_cycles;
+
+    scheduler_charge(gb); // Instruction timing still owes the last op of the pass
+    if (gb->scheduler->next != next || p->pc != block->ops[0].address) return;
+    if (processor_is_pending(gb) || gb->dma->active) return;
+
+    uint32_t count = shape & PROCESSOR_COPY_COUNT_BC ? p->bc : shape & PROCESSOR_COPY_COUNT_B ? p->b : p->c;
+    if (count == 0) count = shape & PROCESSOR_COPY_COUNT_BC ? 0x10000 : 0x100;
+    uint64_t passes = count - 1;
+    if (next != SCHEDULER_NEVER && (next - 1 - gb->scheduler->clock) / cycles < passes) passes = (next - 1 - gb->scheduler->clock) / cycles;
+    if (passes == 0) return;
+
+    bool const copy = shape & (PROCESSOR_COPY_FROM_HL | PROCESSOR_COPY_FROM_DE);
+    uint8_t const reload = block->ops[0].opcode == 0x3E ? 2 : block->ops[0].opcode == 0xAF ? 1 : 0;
+    uint8_t const read_offset = reload + 1;
+    uint8_t const write_offset = reload + (copy ? 3 : 1);
+
+    uint16_t source = shape & PROCESSOR_COPY_FROM_DE ? p->de : p->hl;
+    uint16_t destination = shape & PROCESSOR_COPY_FROM_HL ? p->de : p->hl;
+    uint8_t value = reload == 2 ? block->ops[0].operands[0] : reload == 1 ? 0 : p->a;
+    uint64_t start = gb->scheduler->clock;
+    uint64_t done = 0;
+    while (done < passes) {
+        if (copy && !processor_is_bulk_readable(source)) break;
+        if (!processor_is_bulk_writable(destination)) break;
+
+        if (copy) {
+            gb->scheduler->clock = start + read_offset;
+            value = gameboy_read(gb, source++);
+        }
+        gb->scheduler->clock = start + write_offset;
+        gameboy_write(gb, destination, value);
+        destination += shape & PROCESSOR_COPY_DOWN ? -1 : 1;
+        start += cycles;
+        done += 1;
+
+        // Writing over the loop itself leaves the rest to the freshly decoded code
+        if (block->length == 0) break;
+    }
+    gb->scheduler->clock = start;
+    if (done == 0) return;
+
+    if (copy) {
+        p->hl += done;
+        p->de += done;
+    }
+    else if (shape & PROCESSOR_COPY_DOWN) p->hl -= done;
+    else p->hl += done;
+
+    if (shape & PROCESSOR_COPY_COUNT_BC) {
+        p->bc -= done;
+        p->a = processor_logic(p, p->b | p->c, 0);
+    }
+    else {
+        uint8_t * const counter = shape & PROCESSOR_COPY_COUNT_B ? &p->b : &p->c;
+        *counter = processor_dec(p, *counter - (done - 1));
+        p->a = value;
+    }
+}
+
+#ifdef TRTLE_THREADED
+#if !defined(__GNUC__)
+#error "Threaded dispatch needs computed goto"
+#endif
+
+#define PROCESSOR_OPCODE_ROW(X, high)\
+    X(high##0) X(high##1) X(high##2) X(high##3) X(high##4) X(high##5) X(high##6) X(high##7)\
+    X(high##8) X(high##9) X(high##A) X(high##B) X(high##C) X(high##D) X(high##E) X(high##F)
+#define PROCESSOR_OPCODES(X)\
+    PROCESSOR_OPCODE_ROW(X, 0) PROCESSOR_OPCODE_ROW(X, 1) PROCESSOR_OPCODE_ROW(X, 2) PROCESSOR_OPCODE_ROW(X, 3)\
+    PROCESSOR_OPCODE_ROW(X, 4) PROCESSOR_OPCODE_ROW(X, 5) PROCESSOR_OPCODE_ROW(X, 6) PROCESSOR_OPCODE_ROW(X, 7)\
+    PROCESSOR_OPCODE_ROW(X, 8) PROCESSOR_OPCODE_ROW(X, 9) PROCESSOR_OPCODE_ROW(X, A) PROCESSOR_OPCODE_ROW(X, B)\
+    PROCESSOR_OPCODE_ROW(X, C) PROCESSOR_OPCODE_ROW(X, D) PROCESSOR_OPCODE_ROW(X, E) PROCESSOR_OPCODE_ROW(X, F)
+
+#define PROCESSOR_THREADED_LABEL(code) &&op_##code,
+#define PROCESSOR_THREADED_OP(code) op_##code: instructions[0x##code](gb); PROCESSOR_THREADED_DISPATCH();
+
+// Every handler ends in its own indirect jump to the next op, fetching it as processor_process_instruction would
+// once instruction timing has charged the op that just ran
+#define PROCESSOR_THREADED_DISPATCH() do {\
+    if (++index >= block->length || gb->processor->block != block) {\
+        if (index == block->length && block->idle_cycles != 0) processor_check_idle(gb, block);\
+        else if (index == block->length && block->copy_cycles != 0) processor_run_copy(gb, block, next);\
+        return;\
+    }\
+    if (gb->scheduler->owed != 0) scheduler_charge(gb);\
+    if (gb->scheduler->next != next || processor_is_pending(gb)) return;\
+    op = &block->ops[index];\
+    if (op->address != gb->processor->pc) return;\
+    gb->processor->block_index = index + 1;\
+    gb->processor->operands = op->operands;\
+    gb->processor->pc += 1;\
+    gameboy_cycle(gb);\
+    goto *labels[op->opcode];\
+} while (0)
+
+// Runs the op at index and the ones after it in its block until something needs the checks in
+// processor_process_instruction. Stopping after any scheduler event keeps PPU mode changes visible
+// to gameboy_update_to_vblank on the instruction they happen in.
+static void processor_run_threaded(GameBoy * const gb, ProcessorBlock * const block, size_t index) {
+    static void * const labels[] = { PROCESSOR_OPCODES(PROCESSOR_THREADED_LABEL) };
+    uint64_t const next = gb->scheduler->next;
+    ProcessorOp const * op = &block->ops[index];
+
+    gb->processor->operands = op->operands;
+    gb->processor->pc += 1;
+    gameboy_cycle(gb);
+    goto *labels[op->opcode];
+
+    PROCESSOR_OPCODES(PROCESSOR_THREADED_OP)
+}
+#endif
+
+#if defined(TRTLE_JIT) || defined(TRTLE_AOT)
+// Runs host code for the ops at PC, returning whether any op was retired. Nothing may fire
+// during the run, so the cycles it charges at its exits are never observed early.
+static bool processor_run_native(GameBoy * const gb) {
+    if (processor_is_pending(gb)) return false;
+
+    size_t index;
+    ProcessorBlock * const block = processor_get_current_block(gb, &index);
+    if (block == NULL) return false;
+
+    ProcessorOp * const op = &block->ops[index];
+    if (!op->native_compiled) {
+        op->native_compiled = true;
+#ifdef TRTLE_AOT
+        if (gb->aot != NULL) aot_compile(gb, block, index);
+#endif
+#ifdef TRTLE_JIT
+        if (op->native == NULL && gb->jit != NULL && !jit_compile(gb, block, index)) return false;
+#endif
+    }
+    if (op->native == NULL || gb->scheduler->clock + op->native_cycles >= gb->scheduler->next) return false;
+
+    processor_fold_flags(gb->processor);
+    size_t resume = index + op->native(gb, op->native_entry);
+    processor_resume_block(gb, block, resume);
+
+    // Leaving on the first op hands it to the interpreter
+    return resume != index;
+}
+#endif
+
+// Flags of the ops processor_run_cached runs, computed eagerly on its locals like the plain handlers
+static inline uint8_t processor_cached_inc(uint8_t * const f, uint8_t x) {
+    x += 1;
+    *f &= PROCESSOR_CARRY_BIT;
+    if ((x & 0x0F) == 0) *f |= PROCESSOR_HALF_BIT;
+    if (x == 0) *f |= PROCESSOR_ZERO_BIT;
+    return x;
+}
+
+static inline uint8_t processor_cached_dec(uint8_t * const f, uint8_t x) {
+    x -= 1;
+    *f &= PROCESSOR_CARRY_BIT;
+    *f |= PROCESSOR_NEGATIVE_BIT;
+    if ((x & 0x0F) == 0x0F) *f |= PROCESSOR_HALF_BIT;
+    if (x == 0) *f |= PROCESSOR_ZERO_BIT;
+    return x;
+}
+
+// ADD, ADC, SUB, SBC, AND, XOR, OR or CP of A and y, picked by bits 3-5 of the opcode
+static inline void processor_cached_alu(uint8_t opcode, uint8_t * const a, uint8_t * const f, uint8_t y) {
+    uint8_t const kind = (opcode >> 3) & 0x07;
+    uint8_t const x = *a;
+    uint8_t const carry = (kind == 1 || kind == 3) && (*f & PROCESSOR_CARRY_BIT) ? 1 : 0;
+    uint32_t result;
+    switch (kind) {
+        case 0:
+        case 1:
+            result = x + y + carry;
+            *f = 0;
+            if (((x & 0x0F) + (y & 0x0F) + carry) & 0x10) *f |= PROCESSOR_HALF_BIT;
+            if (result > 0xFF) *f |= PROCESSOR_CARRY_BIT;
+            break;
+        case 2:
+        case 3:
+        case 7:
+            result = (uint32_t)x - y - carry;
+            *f = PROCESSOR_NEGATIVE_BIT;
+            if ((x & 0x0F) < (y & 0x0F) + carry) *f |= PROCESSOR_HALF_BIT;
+            if (result > 0xFF) *f |= PROCESSOR_CARRY_BIT;
+            break;
+        case 4:
+            result = x & y;
+            *f = PROCESSOR_HALF_BIT;
+            break;
+        case 5:
+            result = x ^ y;
+            *f = 0;
+            break;
+        default:
+            result = x | y;
+            *f = 0;
+            break;
+    }
+    if ((result & 0xFF) == 0) *f |= PROCESSOR_ZERO_BIT;
+    if (kind != 7) *a = result;
+}
+
+// Registers by their index in the opcode encoding, 6 being (HL)
+#define PROCESSOR_CACHED_REGISTERS(X)\
+    X(0, b) X(1, c) X(2, d) X(3, e) X(4, h) X(5, l) X(7, a)
+#define PROCESSOR_CACHED_SOURCES(X, index, reg)\
+    X(index, reg, 0, b) X(index, reg, 1, c) X(index, reg, 2, d) X(index, reg, 3, e)\
+    X(index, reg, 4, h) X(index, reg, 5, l) X(index, reg, 7, a)
+
+// Refuses an op that could reach the next event, it runs through processor_process_instruction
+#define PROCESSOR_CACHED_CYCLES(count)\
+    if (clock + (count) >= next) goto spill;\
+    cycles = (count);
+
+// Memory is only touched through the page table, a handler page hands the op to the interpreter
+#define PROCESSOR_CACHED_READ(value, address) {\
+    uint16_t const at = (address);\
+    uint8_t const * const page = gb->read_pages[at >> 8];\
+    if (page == NULL) goto spill;\
+    value = page[at & 0xFF];\
+}
+#define PROCESSOR_CACHED_WRITE(address, value) {\
+    uint16_t const at = (address);\
+    uint8_t * const page = gb->write_pages[at >> 8];\
+    if (page == NULL) goto spill;\
+    page[at & 0xFF] = value;\
+}
+
+// IO registers go through their plain byte, the ones with side effects have none
+#define PROCESSOR_CACHED_READ_IO(value, reg) {\
+    uint8_t const * const byte = gb->io_read_bytes[reg];\
+    if (byte == NULL) goto spill;\
+    value = *byte | gb->io_masks[reg];\
+}
+#define PROCESSOR_CACHED_WRITE_IO(reg, value) {\
+    uint8_t * const byte = gb->io_write_bytes[reg];\
+    if (byte == NULL) goto spill;\
+    *byte = value;\
+}
+
+#define PROCESSOR_CACHED_LD(index, reg, source_index, source)\
+    case 0x40 | (index) << 3 | (source_index): PROCESSOR_CACHED_CYCLES(1) reg = source; break;
+
+#define PROCESSOR_CACHED_REGISTER(index, reg)\
+    case 0x04 | (index) << 3: PROCESSOR_CACHED_CYCLES(1) reg = processor_cached_inc(&f, reg); break;\
+    case 0x05 | (index) << 3: PROCESSOR_CACHED_CYCLES(1) reg = processor_cached_dec(&f, reg); break;\
+    case 0x06 | (index) << 3: PROCESSOR_CACHED_CYCLES(2) reg = op->operands[0]; break;\
+    case 0x46 | (index) << 3: PROCESSOR_CACHED_CYCLES(2) PROCESSOR_CACHED_READ(reg, h << 8 | l) break;\
+    case 0x70 | (index): PROCESSOR_CACHED_CYCLES(2) PROCESSOR_CACHED_WRITE(h << 8 | l, reg) break;\
+    case 0x80 | (index): case 0x88 | (index): case 0x90 | (index): case 0x98 | (index):\
+    case 0xA0 | (index): case 0xA8 | (index): case 0xB0 | (index): case 0xB8 | (index):\
+        PROCESSOR_CACHED_CYCLES(1) processor_cached_alu(op->opcode, &a, &f, reg); break;\
+    PROCESSOR_CACHED_SOURCES(PROCESSOR_CACHED_LD, index, reg)
+
+#define PROCESSOR_CACHED_PAIR(high, low, update) {\
+    uint16_t pair = (high) << 8 | (low);\
+    update;\
+    high = pair >> 8;\
+    low = pair;\
+}
+
+#define PROCESSOR_CACHED_ADD_HL(add) {\
+    uint16_t const initial = h << 8 | l;\
+    uint16_t const value = (add);\
+    f &= PROCESSOR_ZERO_BIT;\
+    if (((initial & 0x0FFF) + (value & 0x0FFF)) & 0x1000) f |= PROCESSOR_HALF_BIT;\
+    if ((((uint32_t)initial) + ((uint32_t)value)) & 0x10000) f |= PROCESSOR_CARRY_BIT;\
+    h = (uint16_t)(initial + value) >> 8;\
+    l = initial + value;\
+}
+
+// Runs ops straight from the decoded blocks with the register file held in locals, stopping before
+// the clock could reach the next event or until, and at the first op outside the subset handled
+// here: anything touching a handler page or an IO register with side effects, the stack,
+// interrupts or the HALT and EI machinery.
+// The registers are spilled back then, and processor_process_instruction takes over from that op.
+// Idle and copy loops are left to it as well, so their skips still apply.
+bool processor_run_cached(GameBoy * const gb, uint64_t until) {
+#ifdef TRTLE_PAIR_PROFILE
+    return false;
+#endif
+    // Without room for the longest op before the next event the run would not be worth its spill
+    Processor * const p = gb->processor;
+    if (gb->scheduler->clock + 4 >= gb->scheduler->next || gb->jit != NULL || gb->aot != NULL) return false;
+    if (p->step.kind != PROCESSOR_STEP_NONE || processor_is_pending(gb)) return false;
+
+    size_t index;
+    ProcessorBlock * block = processor_get_current_block(gb, &index);
+    if (block == NULL || block->idle_cycles != 0 || block->copy_cycles != 0) return false;
+
+    processor_fold_flags(p);
+    uint8_t a = p->a, f = p->f, b = p->b, c = p->c, d = p->d, e = p->e, h = p->h, l = p->l;
+    uint16_t sp = p->sp, pc = p->pc;
+    uint64_t clock = gb->scheduler->clock;
+    uint64_t const next = gb->scheduler->next;
+    size_t retired = 0;
+
+    while (clock < until) {
+        if (index >= block->length || block->ops[index].address != pc) {
+            p->pc = pc;
+            block = processor_get_current_block(gb, &index);
+            if (block == NULL || block->idle_cycles != 0 || block->copy_cycles != 0) break;
+        }
+
+        ProcessorOp const * const op = &block->ops[index];
+        if (op->prefixed) break;
+
+        uint16_t target = pc + op->length;
+        uint8_t cycles;
+        switch (op->opcode) {
+            PROCESSOR_CACHED_REGISTERS(PROCESSOR_CACHED_REGISTER)
+
+            case 0x00: PROCESSOR_CACHED_CYCLES(1) break;
+            case 0x01: PROCESSOR_CACHED_CYCLES(3) b = op->operands[1]; c = op->operands[0]; break;
+            case 0x11: PROCESSOR_CACHED_CYCLES(3) d = op->operands[1]; e = op->operands[0]; break;
+            case 0x21: PROCESSOR_CACHED_CYCLES(3) h = op->operands[1]; l = op->operands[0]; break;
+            case 0x31: PROCESSOR_CACHED_CYCLES(3) sp = op->operands[1] << 8 | op->operands[0]; break;
+            case 0x03: PROCESSOR_CACHED_CYCLES(2) PROCESSOR_CACHED_PAIR(b, c, pair += 1) break;
+            case 0x13: PROCESSOR_CACHED_CYCLES(2) PROCESSOR_CACHED_PAIR(d, e, pair += 1) break;
+            case 0x23: PROCESSOR_CACHED_CYCLES(2) PROCESSOR_CACHED_PAIR(h, l, pair += 1) break;
+            case 0x33: PROCESSOR_CACHED_CYCLES(2) sp += 1; break;
+            case 0x0B: PROCESSOR_CACHED_CYCLES(2) PROCESSOR_CACHED_PAIR(b, c, pair -= 1) break;
+            case 0x1B: PROCESSOR_CACHED_CYCLES(2) PROCESSOR_CACHED_PAIR(d, e, pair -= 1) break;
+            case 0x2B: PROCESSOR_CACHED_CYCLES(2) PROCESSOR_CACHED_PAIR(h, l, pair -= 1) break;
+            case 0x3B: PROCESSOR_CACHED_CYCLES(2) sp -= 1; break;
+            case 0x09: PROCESSOR_CACHED_CYCLES(2) PROCESSOR_CACHED_ADD_HL(b << 8 | c) break;
+            case 0x19: PROCESSOR_CACHED_CYCLES(2) PROCESSOR_CACHED_ADD_HL(d << 8 | e) break;
+            case 0x29: PROCESSOR_CACHED_CYCLES(2) PROCESSOR_CACHED_ADD_HL(h << 8 | l) break;
+            case 0x39: PROCESSOR_CACHED_CYCLES(2) PROCESSOR_CACHED_ADD_HL(sp) break;
+
+            case 0x02: PROCESSOR_CACHED_CYCLES(2) PROCESSOR_CACHED_WRITE(b << 8 | c, a) break;
+            case 0x12: PROCESSOR_CACHED_CYCLES(2) PROCESSOR_CACHED_WRITE(d << 8 | e, a) break;
+            case 0x0A: PROCESSOR_CACHED_CYCLES(2) PROCESSOR_CACHED_READ(a, b << 8 | c) break;
+            case 0x1A: PROCESSOR_CACHED_CYCLES(2) PROCESSOR_CACHED_READ(a, d << 8 | e) break;
+            case 0x22: PROCESSOR_CACHED_CYCLES(2) PROCESSOR_CACHED_WRITE(h << 8 | l, a) PROCESSOR_CACHED_PAIR(h, l, pair += 1) break;
+            case 0x32: PROCESSOR_CACHED_CYCLES(2) PROCESSOR_CACHED_WRITE(h << 8 | l, a) PROCESSOR_CACHED_PAIR(h, l, pair -= 1) break;
+            case 0x2A: PROCESSOR_CACHED_CYCLES(2) PROCESSOR_CACHED_READ(a, h << 8 | l) PROCESSOR_CACHED_PAIR(h, l, pair += 1) break;
+            case 0x3A: PROCESSOR_CACHED_CYCLES(2) PROCESSOR_CACHED_READ(a, h << 8 | l) PROCESSOR_CACHED_PAIR(h, l, pair -= 1) break;
+            case 0xEA: PROCESSOR_CACHED_CYCLES(4) PROCESSOR_CACHED_WRITE(op->operands[1] << 8 | op->operands[0], a) break;
+            case 0xFA: PROCESSOR_CACHED_CYCLES(4) PROCESSOR_CACHED_READ(a, op->operands[1] << 8 | op->operands[0]) break;
+            case 0xE0: PROCESSOR_CACHED_CYCLES(3) PROCESSOR_CACHED_WRITE_IO(op->operands[0], a) break;
+            case 0xF0: PROCESSOR_CACHED_CYCLES(3) PROCESSOR_CACHED_READ_IO(a, op->operands[0]) break;
+            case 0xE2: PROCESSOR_CACHED_CYCLES(2) PROCESSOR_CACHED_WRITE_IO(c, a) break;
+            case 0xF2: PROCESSOR_CACHED_CYCLES(2) PROCESSOR_CACHED_READ_IO(a, c) break;
+
+            case 0x86: case 0x8E: case 0x96: case 0x9E: case 0xA6: case 0xAE: case 0xB6: case 0xBE: {
+                PROCESSOR_CACHED_CYCLES(2)
+                uint8_t value;
+                PROCESSOR_CACHED_READ(value, h << 8 | l)
+                processor_cached_alu(op->opcode, &a, &f, value);
+                break;
+            }
+            case 0xC6: case 0xCE: case 0xD6: case 0xDE: case 0xE6: case 0xEE: case 0xF6: case 0xFE:
+                PROCESSOR_CACHED_CYCLES(2)
+                processor_cached_alu(op->opcode, &a, &f, op->operands[0]);
+                break;
+
+            case 0x07: PROCESSOR_CACHED_CYCLES(1) f = (a & 0x80) ? PROCESSOR_CARRY_BIT : 0; a = a << 1 | a >> 7; break;
+            case 0x0F: PROCESSOR_CACHED_CYCLES(1) f = (a & 0x01) ? PROCESSOR_CARRY_BIT : 0; a = a >> 1 | a << 7; break;
+            case 0x17: {
+                PROCESSOR_CACHED_CYCLES(1)
+                uint8_t const carry = (f & PROCESSOR_CARRY_BIT) != 0;
+                f = (a & 0x80) ? PROCESSOR_CARRY_BIT : 0;
+                a = a << 1 | carry;
+                break;
+            }
+            case 0x1F: {
+                PROCESSOR_CACHED_CYCLES(1)
+                uint8_t const carry = (f & PROCESSOR_CARRY_BIT) != 0;
+                f = (a & 0x01) ? PROCESSOR_CARRY_BIT : 0;
+                a = a >> 1 | carry << 7;
+                break;
+            }
+            case 0x2F: PROCESSOR_CACHED_CYCLES(1) a ^= 0xFF; f |= PROCESSOR_NEGATIVE_BIT | PROCESSOR_HALF_BIT; break;
+            case 0x37: PROCESSOR_CACHED_CYCLES(1) f = (f & PROCESSOR_ZERO_BIT) | PROCESSOR_CARRY_BIT; break;
+            case 0x3F: PROCESSOR_CACHED_CYCLES(1) f = (f & PROCESSOR_ZERO_BIT) | ((f ^ PROCESSOR_CARRY_BIT) & PROCESSOR_CARRY_BIT); break;
+
+            case 0x18: PROCESSOR_CACHED_CYCLES(3) target += (int8_t)op->operands[0]; break;
+            case 0x20: case 0x28: case 0x30: case 0x38: {
+                PROCESSOR_CACHED_CYCLES(3)
+                bool const set = (f & (op->opcode & 0x10 ? PROCESSOR_CARRY_BIT : PROCESSOR_ZERO_BIT)) != 0;
+                if (set == ((op->opcode & 0x08) != 0)) target += (int8_t)op->operands[0];
+                else cycles = 2;
+                break;
+            }
+            case 0xC3: PROCESSOR_CACHED_CYCLES(4) target = op->operands[1] << 8 | op->operands[0]; break;
+            case 0xC2: case 0xCA: case 0xD2: case 0xDA: {
+                PROCESSOR_CACHED_CYCLES(4)
+                bool const set = (f & (op->opcode & 0x10 ? PROCESSOR_CARRY_BIT : PROCESSOR_ZERO_BIT)) != 0;
+                if (set == ((op->opcode & 0x08) != 0)) target = op->operands[1] << 8 | op->operands[0];
+                else cycles = 3;
+                break;
+            }
+
+            default: goto spill;
+        }
+
+        clock += cycles;
+        pc = target;
+        index += 1;
+        retired += 1;
+    }
+
+spill:
+    if (retired == 0) return false;
+    p->a = a;
+    p->f = f;
+    p->b = b;
+    p->c = c;
+    p->d = d;
+    p->e = e;
+    p->h = h;
+    p->l = l;
+    p->sp = sp;
+    p->pc = pc;
+    gb->scheduler->clock = clock;
+    processor_resume_block(gb, block, index);
+    return true;
+}
+
+// The stepping CPU runs what processor_process_instruction does through the plain fetch path, but
+// can stop on any M-cycle: the scheduler calls processor_yield when the clock reaches its stop.
+// Whatever the unit decided up front is latched in p->step, so replaying it after the stop is
+// deterministic however IF, IE or the clock moved in between.
+static void processor_step_begin(GameBoy * const gb) {
+    Processor * const p = gb->processor;
+    InterruptController * const ic = gb->interrupt_controller;
+    ProcessorStep * const step = &p->step;
+
+    step->start = gb->scheduler->clock;
+    step->read_count = 0;
+    step->af = p->af;
+    step->bc = p->bc;
+    step->de = p->de;
+    step->hl = p->hl;
+    step->sp = p->sp;
+    step->pc = p->pc;
+    step->halt_mode = p->halt_mode;
+    step->skip_pc_increment = p->skip_pc_increment;
+    step->skip_next_interrupt = p->skip_next_interrupt;
+    step->ime = ic->ime;
+    step->cycles_until_ime = ic->cycles_until_ime;
+#ifdef TRTLE_LAZY_FLAGS
+    step->lazy_flags = p->lazy_flags;
+    step->flags_operands = p->flags_operands;
+    step->flags_result = p->flags_result;
+#endif
+
+    step->kind = p->halt_mode && (ic->flags & ic->enables & 0x1F) == 0 ? PROCESSOR_STEP_HALTED : PROCESSOR_STEP_INSTRUCTION;
+    step->priority = -1;
+    if (step->kind == PROCESSOR_STEP_INSTRUCTION && (ic->pending & 0x1F) != 0 && !p->skip_next_interrupt) {
+        step->priority = interrupt_priorities[ic->pending & 0x1F];
+    }
+}
+
+static void processor_step_restore(GameBoy * const gb) {
+    Processor * const p = gb->processor;
+    InterruptController * const ic = gb->interrupt_controller;
+    ProcessorStep const * const step = &p->step;
+
+    p->af = step->af;
+    p->bc = step->bc;
+    p->de = step->de;
+    p->hl = step->hl;
+    p->sp = step->sp;
+    p->pc = step->pc;
+    p->halt_mode = step->halt_mode;
+    p->skip_pc_increment = step->skip_pc_increment;
+    p->skip_next_interrupt = step->skip_next_interrupt;
+    ic->ime = step->ime;
+    ic->cycles_until_ime = step->cycles_until_ime;
+    interrupt_controller_update(ic);
+#ifdef TRTLE_LAZY_FLAGS
+    p->lazy_flags = step->lazy_flags;
+    p->flags_operands = step->flags_operands;
+    p->flags_result = step->flags_result;
+#endif
+}
+
+// processor_process_instruction's plain path with the decisions taken from the step. The EI
+// countdown runs unconditionally, it is a no-op whenever the pending word has no EI bit.
+static void processor_step_run(GameBoy * const gb) {
+    Processor * const p = gb->processor;
+    InterruptController * const ic = gb->interrupt_controller;
+    ProcessorStep const * const step = &p->step;
+
+    if (step->kind == PROCESSOR_STEP_HALTED) {
+        if (gb->scheduler->next != SCHEDULER_NEVER) gb->scheduler->clock = gb->scheduler->next - 1;
+        gameboy_cycle(gb);
+        return;
+    }
+    p->halt_mode = false;
+
+    if (step->priority >= 0) {
+        interrupt_controller_set_ime(gb, false);
+        processor_write(gb, INTERRUPT_FLAGS_ADDRESS, ic->flags & ~(1 << step->priority));
+        gameboy_cycle(gb);
+        interrupt_vectors[step->priority](gb);
+        gameboy_cycle(gb);
+    }
+
+    if (ic->cycles_until_ime > 0) ic->cycles_until_ime -= 1;
+    if (ic->cycles_until_ime == 0) {
+        ic->cycles_until_ime = -1;
+        interrupt_controller_set_ime(gb, true);
+    }
+    p->skip_next_interrupt = false;
+
+    uint8_t opcode = processor_read(gb, p->pc);
+    if (p->skip_pc_increment) p->skip_pc_increment = false;
+    else p->pc += 1;
+    gameboy_cycle(gb);
+
+    instructions[opcode](gb);
+}
+
+// Runs one unit, or the rest of the one in flight. That one is replayed from its start with the
+// clock wound back, and the stop moved to where it left off hands it back to the bus there.
+static void processor_step(GameBoy * const gb) {
+    Processor * const p = gb->processor;
+    if (p->step.kind == PROCESSOR_STEP_NONE) processor_step_begin(gb);
+    else {
+        processor_step_restore(gb);
+        p->replaying = true;
+        p->replay_index = 0;
+        scheduler_set_stop(gb, gb->scheduler->clock);
+        gb->scheduler->clock = p->step.start;
+    }
+    processor_step_run(gb);
+    p->step.kind = PROCESSOR_STEP_NONE;
+}
+
+void processor_yield(GameBoy * const gb) {
+    Processor * const p = gb->processor;
+    if (p->replaying) {
+        p->replaying = false;
+        scheduler_set_stop(gb, p->step_stop);
+        return;
+    }
+    scheduler_set_stop(gb, SCHEDULER_NEVER);
+    longjmp(p->step_yield, 1);
+}
+
+// Runs the stepping CPU until the clock reads exactly clock, which can leave a unit in flight.
+// Instruction timing is off meanwhile, since the stop has to be reached cycle by cycle.
+void processor_run_to(GameBoy * const gb, uint64_t clock) {
+    Processor * const p = gb->processor;
+    bool const instruction_timing = gb->instruction_timing;
+    gameboy_set_instruction_timing(gb, false);
+
+    if (gb->scheduler->clock < clock) {
+        p->stepping = true;
+        p->step_stop = clock;
+        if (setjmp(p->step_yield) == 0) {
+            scheduler_set_stop(gb, clock);
+            while (true) processor_step(gb);
+        }
+        p->stepping = false;
+    }
+
+    gameboy_set_instruction_timing(gb, instruction_timing);
+    gameboy_update_run_state(gb);
+}
+
+// Finishes the unit the stepping CPU left in flight, without a stop to yield on
+static void processor_finish_step(GameBoy * const gb) {
+    Processor * const p = gb->processor;
+    bool const instruction_timing = gb->instruction_timing;
+    gameboy_set_instruction_timing(gb, false);
+
+    p->stepping = true;
+    p->step_stop = SCHEDULER_NEVER;
+    processor_step(gb);
+    p->stepping = false;
+
+    gameboy_set_instruction_timing(gb, instruction_timing);
+    gameboy_update_run_state(gb);
+}
+
 void processor_process_instruction(GameBoy * const gb) {
+    if (gb->processor->step.kind != PROCESSOR_STEP_NONE) {
+        processor_finish_step(gb);
+        return;
+    }
+
+#if defined(TRTLE_JIT) || defined(TRTLE_AOT)
+    if ((gb->jit != NULL || gb->aot != NULL) && processor_run_native(gb)) return;
+#endif
+
     if (gb->processor->halt_mode) {
         uint8_t interrupts = gb->interrupt_controller->flags & gb->interrupt_controller->enables & 0x1F;
         if (interrupts == 0) {
+            // Only an event can raise an interrupt, so the halted cycles before the next one are skipped
+            if (gb->scheduler->next != SCHEDULER_NEVER) gb->scheduler->clock = gb->scheduler->next - 1;
             gameboy_cycle(gb);
             return; // Notice this and don't reorder it
         }
         gb->processor->halt_mode = false;
+        gameboy_update_run_state(gb);
     }
 
-    if (gb->interrupt_controller->ime && !gb->processor->skip_next_interrupt) {
-        uint8_t interrupts = gb->interrupt_controller->flags & gb->interrupt_controller->enables;
-        if (interrupts & VBLANK_INTERRUPT_BIT) {
-            gb->interrupt_controller->ime = false;
-            gameboy_write(gb, INTERRUPT_FLAGS_ADDRESS, gb->interrupt_controller->flags & ~VBLANK_INTERRUPT_BIT);
-            gameboy_cycle(gb);
-            rst_40h(gb);
-            gameboy_cycle(gb);
-        }
-        else if (interrupts & LCD_STAT_INTERRUPT_BIT) {
-            gb->interrupt_controller->ime = false;
-            gameboy_write(gb, INTERRUPT_FLAGS_ADDRESS, gb->interrupt_controller->flags & ~LCD_STAT_INTERRUPT_BIT);
-            gameboy_cycle(gb);
-            rst_48h(gb);
-            gameboy_cycle(gb);
-        }
-        else if (interrupts & TIMER_INTERRUPT_BIT) {
-            gb->interrupt_controller->ime = false;
-            gameboy_write(gb, INTERRUPT_FLAGS_ADDRESS, gb->interrupt_controller->flags & ~TIMER_INTERRUPT_BIT);
-            gameboy_cycle(gb);
-            rst_50h(gb);
-            gameboy_cycle(gb);
-        }
-        else if (interrupts & SERIAL_INTERRUPT_BIT) {
-            gb->interrupt_controller->ime = false;
-            gameboy_write(gb, INTERRUPT_FLAGS_ADDRESS, gb->interrupt_controller->flags & ~SERIAL_INTERRUPT_BIT);
+    // The pending word is only non-zero with an interrupt to service or an EI waiting
+    InterruptController * const ic = gb->interrupt_controller;
+    if (ic->pending != 0) {
+        uint8_t interrupts = ic->pending & 0x1F;
+        if (interrupts != 0 && !gb->processor->skip_next_interrupt) {
+            uint8_t priority = interrupt_priorities[interrupts];
+            interrupt_controller_set_ime(gb, false);
+            gameboy_write(gb, INTERRUPT_FLAGS_ADDRESS, ic->flags & ~(1 << priority));
             gameboy_cycle(gb);
-            rst_58h(gb);
+            interrupt_vectors[priority](gb);
             gameboy_cycle(gb);
         }
-        else if (interrupts & JOYPAD_INTERRUPT_BIT) {
-            gb->interrupt_controller->ime = false;
-            gameboy_write(gb, INTERRUPT_FLAGS_ADDRESS, gb->interrupt_controller->flags & ~JOYPAD_INTERRUPT_BIT);
-            gameboy_cycle(gb);
-            rst_60h(gb);
-            gameboy_cycle(gb);
+
+        if (ic->cycles_until_ime > 0) ic->cycles_until_ime -= 1;
+        if (ic->cycles_until_ime == 0) {
+            ic->cycles_until_ime = -1;
+            interrupt_controller_set_ime(gb, true);
         }
     }
     gb->processor->skip_next_interrupt = false;
 
-    if (gb->interrupt_controller->cycles_until_ime > 0) gb->interrupt_controller->cycles_until_ime -= 1;
-    if (gb->interrupt_controller->cycles_until_ime == 0) {
-        gb->interrupt_controller->cycles_until_ime = -1;
-        gb->interrupt_controller->ime = 1;
+    // The HALT bug re-reads the opcode byte, which only the plain fetch path below models
+    ProcessorOp const * op = gb->processor->skip_pc_increment ? NULL : processor_get_op(gb);
+    if (op != NULL) {
+        ProcessorBlock * const block = gb->processor->block;
+#ifdef TRTLE_THREADED
+        processor_run_threaded(gb, block, gb->processor->block_index - 1);
+        gb->processor->operands = NULL;
+        return;
+#endif
+        uint64_t const next = gb->scheduler->next;
+        gb->processor->pc += 1;
+        gameboy_cycle(gb);
+        if (op->prefixed) {
+            gb->processor->pc += 1;
+            gameboy_cycle(gb);
+        }
+
+#ifdef TRTLE_PAIR_PROFILE
+        if (op != block->ops && gb->processor->profile_last == op - 1 && !op->prefixed && !op[-1].prefixed) {
+            gb->processor->pair_counts[op[-1].opcode][op->opcode] += 1;
+        }
+        gb->processor->profile_last = op;
+#endif
+
+        gb->processor->operands = op->operands + op->prefixed;
+        if (op->fused != NULL) op->fused(gb, op, next);
+        else op->execute(gb);
+        gb->processor->operands = NULL;
+        if (block->idle_cycles != 0 && gb->processor->block_index == block->length) processor_check_idle(gb, block);
+        else if (block->copy_cycles != 0 && gb->processor->block_index == block->length) processor_run_copy(gb, block, next);
+        return;
     }
 
     uint8_t opcode = gameboy_read(gb, gb->processor->pc);
@@ -1354,3 +2477,24 @@ void processor_process_instruction(GameBoy * const gb) {
 
     instructions[opcode](gb);
 }
+
+// Runs a halted CPU up to until an event at a time, waking it through processor_process_instruction
+// once an interrupt is pending. Nothing but an event can raise one, so the cycles between are skipped.
+void processor_run_halted(GameBoy * const gb, uint64_t until) {
+    InterruptController * const ic = gb->interrupt_controller;
+    if (gb->processor->step.kind != PROCESSOR_STEP_NONE || !gb->processor->halt_mode) {
+        processor_process_instruction(gb);
+        return;
+    }
+
+    while (gb->scheduler->clock < until) {
+        if ((ic->flags & ic->enables & 0x1F) != 0) {
+            processor_process_instruction(gb);
+            return;
+        }
+        uint64_t const next = gb->scheduler->next < until ? gb->scheduler->next : until;
+        gb->scheduler->clock = next - 1;
+        gameboy_cycle(gb);
+        if (gb->instruction_timing) scheduler_charge(gb);
+    }
+}
@@ -1,13 +1,89 @@
 #ifndef TRTLE_PROCESSOR_H
 #define TRTLE_PROCESSOR_H
 
+#include <setjmp.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #define PROCESSOR_CLOCK_SPEED (4194304)
 
+// Decoded block cache
+#define PROCESSOR_BLOCK_COUNT  (1024)
+#define PROCESSOR_BLOCK_LENGTH (32)
+
+#define PROCESSOR_NATIVE_JUMPED (PROCESSOR_BLOCK_LENGTH)
+
+// Bus reads one unit of the stepping CPU can make, an interrupt dispatch and CB (HL) op included
+#define PROCESSOR_STEP_READS (8)
+
 typedef struct GameBoy GameBoy;
 
+// A single pre-decoded instruction, the operand bytes stand in for bus fetches when it runs
+typedef struct ProcessorOp {
+    void (*execute)(GameBoy * const gb);
+    uint16_t address;
+    uint8_t opcode;
+    uint8_t length;
+    uint8_t operands[2];
+    bool prefixed;
+
+    // Runs this op and the next as one handler when the pair is in PROCESSOR_FUSED_PAIRS, stopping
+    // after the first whenever the second would need the checks in processor_process_instruction
+    void (*fused)(GameBoy * const gb, struct ProcessorOp const * const op, uint64_t next);
+
+    // Host code for the ops starting here, filled in by the JIT or an AOT module. It is entered at
+    // native_entry and returns how many ops it retired, or PROCESSOR_NATIVE_JUMPED once it branched.
+    size_t (*native)(GameBoy * const gb, size_t entry);
+    uint8_t native_entry;
+    uint8_t native_cycles;
+    bool native_compiled;
+} ProcessorOp;
+
+// A straight-line run of instructions decoded from host memory, never crossing a 256-byte page
+typedef struct ProcessorBlock {
+    uint8_t const * code;
+    uint8_t const * end;
+    size_t length;
+    size_t idle_cycles;    // M-cycles of one pass when the block is an idle loop, otherwise 0
+    uint8_t idle_pointers; // Register pairs an idle loop reads memory through
+    uint8_t copy_cycles;   // M-cycles of one pass when the block is a copy or fill loop, otherwise 0
+    uint8_t copy_shape;    // Pointers and counter of a copy or fill loop
+    ProcessorOp ops[PROCESSOR_BLOCK_LENGTH];
+} ProcessorBlock;
+
+// What the stepping CPU runs as one unit, either a halted cycle or an instruction along with the
+// interrupt dispatch and EI countdown processor_process_instruction would run before it
+typedef enum ProcessorStepKind {
+    PROCESSOR_STEP_NONE = 0,
+    PROCESSOR_STEP_HALTED,
+    PROCESSOR_STEP_INSTRUCTION
+} ProcessorStepKind;
+
+// The unit the stepping CPU stopped inside of. It is plain data, so it round-trips through a save
+// state as is: resuming replays the unit from the state it started in, with its reads returning
+// what they returned the first time and its writes left out, up to the cycle it stopped on.
+typedef struct ProcessorStep {
+    uint8_t kind;
+    int8_t priority;   // Interrupt the unit dispatches, or -1
+    uint8_t read_count;
+    uint8_t reads[PROCESSOR_STEP_READS];
+    uint64_t start;    // Clock the unit started on
+
+    // State at the start of the unit
+    uint16_t af, bc, de, hl, sp, pc;
+    bool halt_mode;
+    bool skip_pc_increment;
+    bool skip_next_interrupt;
+    bool ime;
+    int8_t cycles_until_ime;
+#ifdef TRTLE_LAZY_FLAGS
+    uint8_t lazy_flags;
+    uint8_t flags_operands;
+    uint16_t flags_result;
+#endif
+} ProcessorStep;
+
 typedef struct Processor {
     union {
         uint16_t af;
@@ -64,10 +140,49 @@ typedef struct Processor {
     bool halt_mode;
     bool skip_pc_increment;
     bool skip_next_interrupt;
+#ifdef TRTLE_LAZY_FLAGS
+    uint8_t lazy_flags;      // Flag bits left out of f, see processor_sync_flags
+    uint8_t flags_operands;
+    uint16_t flags_result;
+#endif
+
+    uint8_t const * operands;
+    ProcessorBlock * block;
+    size_t block_index;
+    ProcessorBlock * idle_block; // Idle loop last seen completing a pass, at idle_clock with idle_next pending
+    uint64_t idle_clock;
+    uint64_t idle_next;
+    bool ram_code_pages[8192 / 256];
+    bool code_map[8192 + 0x7F]; // Bytes of WRAM and HRAM that belong to decoded blocks
+    ProcessorBlock blocks[PROCESSOR_BLOCK_COUNT];
+
+    ProcessorStep step;
+    bool stepping;         // The stepping CPU is running, bus accesses go through the step
+    bool replaying;        // Its accesses belong to cycles run before the unit stopped
+    uint8_t replay_index;
+    uint64_t step_stop;
+    jmp_buf step_yield;
+#ifdef TRTLE_PAIR_PROFILE
+    ProcessorOp const * profile_last;
+    uint64_t pair_counts[256][256]; // Times an unprefixed op ran straight after another in a block
+#endif
 } Processor;
 
 void processor_initialize(Processor * const p, bool skip_bootrom);
 
 void processor_process_instruction(GameBoy * const gb);
+bool processor_run_cached(GameBoy * const gb, uint64_t until);
+void processor_run_halted(GameBoy * const gb, uint64_t until);
+
+void processor_run_to(GameBoy * const gb, uint64_t clock);
+void processor_yield(GameBoy * const gb);
+
+// Brings f up to date, anything reading the registers from outside the core calls this first
+void processor_sync_flags(GameBoy * const gb);
+
+ProcessorBlock * processor_get_current_block(GameBoy * const gb, size_t * const index);
+void processor_resume_block(GameBoy * const gb, ProcessorBlock * const block, size_t index);
+void processor_flush_blocks(GameBoy * const gb);
+void processor_invalidate_code(GameBoy * const gb, uint16_t address);
 
 #endif /* !TRTLE_PROCESSOR_H */
@@ -0,0 +1,71 @@
+#include "scheduler.h"
+
+#include <stddef.h>
+
+#include "dma.h"
+#include "gameboy.h"
+#include "ppu.h"
+#include "processor.h"
+#include "timer.h"
+
+static void (* const event_handlers[SCHEDULER_EVENT_COUNT])(GameBoy * const gb) = {
+    dma_event,
+    timer_event,
+    ppu_event
+};
+
+static void scheduler_update_next(Scheduler * const s) {
+    s->next = s->stop;
+    for (size_t i = 0; i < SCHEDULER_EVENT_COUNT; i++) {
+        if (s->events[i] < s->next) s->next = s->events[i];
+    }
+}
+
+void scheduler_initialize(Scheduler * const s, bool skip_bootrom) {
+    s->clock = 0;
+    s->owed = 0;
+    s->stop = SCHEDULER_NEVER;
+    for (size_t i = 0; i < SCHEDULER_EVENT_COUNT; i++) s->events[i] = SCHEDULER_NEVER;
+    s->next = SCHEDULER_NEVER;
+}
+
+void scheduler_schedule(GameBoy * const gb, SchedulerEvent event, uint64_t time) {
+    gb->scheduler->events[event] = time;
+    if (time < gb->scheduler->next) gb->scheduler->next = time;
+    else scheduler_update_next(gb->scheduler);
+}
+
+void scheduler_cancel(GameBoy * const gb, SchedulerEvent event) {
+    gb->scheduler->events[event] = SCHEDULER_NEVER;
+    scheduler_update_next(gb->scheduler);
+}
+
+void scheduler_set_stop(GameBoy * const gb, uint64_t time) {
+    gb->scheduler->stop = time;
+    scheduler_update_next(gb->scheduler);
+}
+
+// The clock never moves past a pending event, so everything due is due now
+void scheduler_run(GameBoy * const gb) {
+    Scheduler * const s = gb->scheduler;
+    for (size_t i = 0; i < SCHEDULER_EVENT_COUNT; i++) {
+        if (s->events[i] <= s->clock) {
+            s->events[i] = SCHEDULER_NEVER;
+            event_handlers[i](gb);
+        }
+    }
+    scheduler_update_next(s);
+    if (s->clock >= s->stop) processor_yield(gb);
+}
+
+// Moves the clock over the owed cycles as gameboy_cycle would have, each event still runs on its own cycle
+void scheduler_charge(GameBoy * const gb) {
+    Scheduler * const s = gb->scheduler;
+    uint64_t const clock = s->clock + s->owed;
+    s->owed = 0;
+    while (s->next <= clock) {
+        if (s->next > s->clock) s->clock = s->next;
+        scheduler_run(gb);
+    }
+    s->clock = clock;
+}
@@ -0,0 +1,36 @@
+#ifndef TRTLE_SCHEDULER_H
+#define TRTLE_SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SCHEDULER_NEVER (UINT64_MAX)
+
+typedef struct GameBoy GameBoy;
+
+// Events due on the same cycle are dispatched in this order
+typedef enum SchedulerEvent {
+    SCHEDULER_EVENT_DMA = 0,
+    SCHEDULER_EVENT_TIMER,
+    SCHEDULER_EVENT_PPU,
+    SCHEDULER_EVENT_COUNT
+} SchedulerEvent;
+
+typedef struct Scheduler {
+    uint64_t clock; // M-cycles elapsed since reset
+    uint64_t next;  // Earliest pending event
+    uint64_t owed;  // M-cycles counted under instruction timing and not yet charged to the clock
+    uint64_t stop;  // Clock the stepping CPU yields on, next never passes it
+    uint64_t events[SCHEDULER_EVENT_COUNT];
+} Scheduler;
+
+void scheduler_initialize(Scheduler * const s, bool skip_bootrom);
+
+void scheduler_schedule(GameBoy * const gb, SchedulerEvent event, uint64_t time);
+void scheduler_cancel(GameBoy * const gb, SchedulerEvent event);
+void scheduler_set_stop(GameBoy * const gb, uint64_t time);
+
+void scheduler_run(GameBoy * const gb);
+void scheduler_charge(GameBoy * const gb);
+
+#endif /* !TRTLE_SCHEDULER_H */
@@ -2,8 +2,6 @@
 
 #include "gameboy.h"
 
-#define SERIAL_SC_MASK (0b01111110)
-
 void serial_initialize(Serial * const s, bool skip_bootrom) {
     // Stub
 }
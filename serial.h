@@ -4,6 +4,8 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#define SERIAL_SC_MASK (0b01111110)
+
 typedef struct GameBoy GameBoy;
 
 typedef struct Serial {
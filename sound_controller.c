@@ -2,13 +2,6 @@
 
 #include "gameboy.h"
 
-#define SOUND_CONTROLLER_NR10_MASK (0b10000000)
-#define SOUND_CONTROLLER_NR30_MASK (0b01111111)
-#define SOUND_CONTROLLER_NR32_MASK (0b10011111)
-#define SOUND_CONTROLLER_NR41_MASK (0b11000000)
-#define SOUND_CONTROLLER_NR44_MASK (0b00111111)
-#define SOUND_CONTROLLER_NR52_MASK (0b01110000)
-
 void sound_controller_initialize(SoundController * const sc, bool skip_bootrom) {
     sc->nr10 = 0x80;
     sc->nr11 = 0xBF;
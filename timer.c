@@ -5,8 +5,8 @@
 #include "interrupt_controller.h"
 #include "processor.h"
 #include "gameboy.h"
+#include "scheduler.h"
 
-#define TIMER_TAC_MASK          (0b11111000)
 #define TIMER_CLOCK_SELECT_BITS (0b00000011)
 #define TIMER_START_BIT         (0b00000100)
 
@@ -18,6 +18,7 @@ void timer_initialize(Timer * const t, bool skip_bootrom) {
     t->tac = 0x00;
     t->tima_overflow = false;
     t->writing_tima = false;
+    t->last_sync = 0;
 }
 
 static uint8_t timer_get_frequency_bit(GameBoy * const gb) {
@@ -37,12 +38,22 @@ static void timer_increment_tima(GameBoy * const gb) {
     if (gb->timer->tima == 0) gb->timer->tima_overflow = true;
 }
 
-void timer_cycle(GameBoy * const gb) {
+static uint8_t timer_get_frequency_shift(GameBoy const * const gb) {
+    switch (gb->timer->tac & TIMER_CLOCK_SELECT_BITS) {
+        case 0b00: return 9;
+        case 0b01: return 3;
+        case 0b10: return 5;
+        case 0b11: return 7;
+    }
+    return 9;
+}
+
+static void timer_cycle(GameBoy * const gb) {
     gb->timer->writing_tima = false;
 
     if (gb->timer->tima_overflow) {
         gb->timer->tima_overflow = false;
-        gb->interrupt_controller->flags |= TIMER_INTERRUPT_BIT;
+        interrupt_controller_request(gb, TIMER_INTERRUPT_BIT);
         gb->timer->tima = gb->timer->tma;
         gb->timer->writing_tima = true;
     }
@@ -54,22 +65,76 @@ void timer_cycle(GameBoy * const gb) {
     if ((gb->timer->tac & TIMER_START_BIT) && old_bit && !new_bit) timer_increment_tima(gb);
 }
 
+// Schedules the next cycle with an observable side effect, which is either a pending overflow
+// or the next falling edge of the selected counter bit
+static void timer_schedule(GameBoy * const gb) {
+    if (gb->timer->tima_overflow) {
+        scheduler_schedule(gb, SCHEDULER_EVENT_TIMER, gb->scheduler->clock + 1);
+    }
+    else if (gb->timer->tac & TIMER_START_BIT) {
+        uint32_t period = 1 << (timer_get_frequency_shift(gb) + 1);
+        uint32_t cycles = (period - (gb->timer->internal_counter & (period - 1))) / 4;
+        scheduler_schedule(gb, SCHEDULER_EVENT_TIMER, gb->scheduler->clock + cycles);
+    }
+    else scheduler_cancel(gb, SCHEDULER_EVENT_TIMER);
+}
+
+// Brings the timer up to the current clock
+void timer_sync(GameBoy * const gb) {
+    uint64_t elapsed = gb->scheduler->clock - gb->timer->last_sync;
+    gb->timer->last_sync = gb->scheduler->clock;
+
+    for (; elapsed > 0; elapsed--) {
+        // A stopped timer can't increment TIMA, so only the counter needs to move
+        if (!(gb->timer->tac & TIMER_START_BIT) && !gb->timer->tima_overflow && !gb->timer->writing_tima) {
+            gb->timer->internal_counter += 4 * elapsed;
+            break;
+        }
+        timer_cycle(gb);
+    }
+}
+
+void timer_event(GameBoy * const gb) {
+    timer_sync(gb);
+    timer_schedule(gb);
+}
+
+uint8_t timer_read_div(GameBoy * const gb) {
+    timer_sync(gb);
+    return gb->timer->div;
+}
+
 void timer_write_div(GameBoy * const gb) {
+    timer_sync(gb);
+
     bool old_bit = timer_get_frequency_bit(gb);
     gb->timer->internal_counter = 0;
     bool new_bit = timer_get_frequency_bit(gb);
 
     if ((gb->timer->tac & TIMER_START_BIT) && old_bit && !new_bit) timer_increment_tima(gb);
+
+    timer_schedule(gb);
+}
+
+uint8_t timer_read_tima(GameBoy * const gb) {
+    timer_sync(gb);
+    return gb->timer->tima;
 }
 
 void timer_write_tima(GameBoy * const gb, uint8_t value) {
+    timer_sync(gb);
+
     if (!gb->timer->writing_tima) {
         gb->timer->tima = value;
         gb->timer->tima_overflow = false;
     }
+
+    timer_schedule(gb);
 }
 
 void timer_write_tma(GameBoy * const gb, uint8_t value) {
+    timer_sync(gb);
+
     gb->timer->tma = value;
     if (gb->timer->writing_tima) gb->timer->tima = value;
 }
@@ -79,9 +144,12 @@ uint8_t timer_read_tac(GameBoy const * const gb) {
 }
 
 void timer_write_tac(GameBoy * const gb, uint8_t value) {
+    timer_sync(gb);
+
     bool old_bit = timer_get_frequency_bit(gb) && gb->timer->tac & TIMER_START_BIT;
     gb->timer->tac = value | TIMER_TAC_MASK;
     bool new_bit = timer_get_frequency_bit(gb) && gb->timer->tac & TIMER_START_BIT;
 
     if (old_bit && !new_bit) timer_increment_tima(gb);
+    timer_schedule(gb);
 }
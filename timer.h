@@ -4,6 +4,8 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#define TIMER_TAC_MASK (0b11111000)
+
 typedef struct GameBoy GameBoy;
 
 typedef struct Timer {
@@ -24,14 +26,18 @@ typedef struct Timer {
     uint8_t tac;
     bool tima_overflow;
     bool writing_tima;
+    uint64_t last_sync;
 } Timer;
 
 void timer_initialize(Timer * const t, bool skip_bootrom);
 
-void timer_cycle(GameBoy * const gb);
+void timer_sync(GameBoy * const gb);
+void timer_event(GameBoy * const gb);
 
+uint8_t timer_read_div(GameBoy * const gb);
 void timer_write_div(GameBoy * const gb);
 
+uint8_t timer_read_tima(GameBoy * const gb);
 void timer_write_tima(GameBoy * const gb, uint8_t value);
 
 void timer_write_tma(GameBoy * const gb, uint8_t value);
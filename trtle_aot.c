@@ -0,0 +1,734 @@
+// Ahead-of-time recompiler, turns the code reachable in a ROM into a module the core loads next to it:
+//
+//     trtle_aot [-k] [-I core_dir] [-o game.aot.so] game.gb
+//
+// Reachable code is split into runs of ops the module can execute on its own, every op of a run can
+// be entered and the run leaves through a side exit whenever an access needs the bus handlers. Code
+// copied to RAM and anything not found by the walk stays with the interpreter or the JIT.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aot.h"
+#include "cartridge.h"
+#include "processor.h"
+
+#ifndef TRTLE_AOT_INCLUDE
+#define TRTLE_AOT_INCLUDE "."
+#endif
+
+#define AOT_BANK_SIZE   (0x4000)
+#define AOT_RUN_LENGTH  (PROCESSOR_BLOCK_LENGTH)
+#define AOT_RUN_CYCLES  (224)
+
+typedef struct AotOp {
+    uint32_t offset;
+    uint16_t address;
+    uint8_t opcode;
+    uint8_t length;
+    uint8_t operands[2];
+    uint8_t cycles; // Longest path through the op
+    uint8_t worst;  // Longest path from the op to the next conditional branch
+} AotOp;
+
+typedef struct AotSeed {
+    size_t bank;
+    uint16_t address;
+} AotSeed;
+
+// An AotEntry before its run has a symbol
+typedef struct AotToolEntry {
+    uint32_t offset;
+    uint16_t address;
+    uint8_t entry;
+    uint8_t cycles;
+    size_t run;
+} AotToolEntry;
+
+typedef struct AotTool {
+    Cartridge * cart;
+    size_t bank_count;
+    FILE * out;
+
+    AotSeed * seeds;
+    size_t seed_count;
+    size_t seed_capacity;
+    bool * visited; // Per ROM offset, a run was started there
+    bool * covered; // Per ROM offset, an op there has an entry
+
+    AotToolEntry * entries;
+    size_t entry_count;
+    size_t entry_capacity;
+    size_t run_count;
+} AotTool;
+
+static char const * const registers[8] = { "p->b", "p->c", "p->d", "p->e", "p->h", "p->l", NULL, "p->a" };
+static char const * const pairs[4] = { "p->bc", "p->de", "p->hl", "p->sp" };
+static char const * const stack_pairs[4] = { "p->bc", "p->de", "p->hl", "p->af" };
+static char const * const alu_helpers[8] = { "aot_add", "aot_adc", "aot_sub", "aot_sbc", "aot_and", "aot_xor", "aot_or", "aot_cp" };
+static char const * const shift_helpers[8] = { "aot_rlc", "aot_rrc", "aot_rl", "aot_rr", "aot_sla", "aot_sra", "aot_swap", "aot_srl" };
+static char const * const conditions[4] = { "!(p->f & AOT_Z)", "(p->f & AOT_Z)", "!(p->f & AOT_C)", "(p->f & AOT_C)" };
+
+// Mirrors operand_lengths in processor.c
+static uint8_t const operand_lengths[] = {
+    0, 2, 0, 0, 0, 0, 1, 0, 2, 0, 0, 0, 0, 0, 1, 0,
+    0, 2, 0, 0, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0, 1, 0,
+    1, 2, 0, 0, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0, 1, 0,
+    1, 2, 0, 0, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0, 1, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 2, 2, 2, 0, 1, 0, 0, 0, 2, 1, 2, 2, 1, 0,
+    0, 0, 2, 0, 2, 0, 1, 0, 0, 0, 2, 0, 2, 0, 1, 0,
+    1, 0, 0, 0, 0, 0, 1, 0, 1, 0, 2, 0, 0, 0, 1, 0,
+    1, 0, 0, 0, 0, 0, 1, 0, 1, 0, 2, 0, 0, 0, 1, 0,
+};
+
+// Helpers the generated code is built from, each one matches its handler in processor.c
+static char const prelude[] =
+    "#include <stdbool.h>\n"
+    "#include <stddef.h>\n"
+    "#include <stdint.h>\n"
+    "\n"
+    "#include \"gameboy.h\"\n"
+    "#include \"interrupt_controller.h\"\n"
+    "#include \"processor.h\"\n"
+    "#include \"scheduler.h\"\n"
+    "#include \"aot.h\"\n"
+    "\n"
+    "#define AOT_Z (0x80)\n"
+    "#define AOT_N (0x40)\n"
+    "#define AOT_H (0x20)\n"
+    "#define AOT_C (0x10)\n"
+    "\n"
+    "static inline void aot_add(Processor * const p, uint8_t v) { uint8_t i = p->a; p->a = i + v; p->f = 0; if (((i & 0x0F) + (v & 0x0F)) & 0x10) p->f |= AOT_H; if (p->a == 0) p->f |= AOT_Z; if (i + v > 0xFF) p->f |= AOT_C; }\n"
+    "static inline void aot_adc(Processor * const p, uint8_t v) { uint8_t i = p->a; uint8_t c = (p->f & AOT_C) != 0; p->a = i + v + c; p->f = 0; if (((i & 0x0F) + (v & 0x0F) + c) & 0x10) p->f |= AOT_H; if (p->a == 0) p->f |= AOT_Z; if (i + v + c > 0xFF) p->f |= AOT_C; }\n"
+    "static inline void aot_sub(Processor * const p, uint8_t v) { uint8_t i = p->a; p->a = i - v; p->f = AOT_N; if ((i & 0x0F) < (v & 0x0F)) p->f |= AOT_H; if (p->a == 0) p->f |= AOT_Z; if (i < v) p->f |= AOT_C; }\n"
+    "static inline void aot_sbc(Processor * const p, uint8_t v) { uint8_t i = p->a; uint8_t c = (p->f & AOT_C) != 0; p->a = i - v - c; p->f = AOT_N; if ((i & 0x0F) < (v & 0x0F) + c) p->f |= AOT_H; if (p->a == 0) p->f |= AOT_Z; if ((uint32_t)i - v - c > 0xFF) p->f |= AOT_C; }\n"
+    "static inline void aot_sbc_a(Processor * const p) { uint8_t i = p->a; uint8_t c = (p->f & AOT_C) != 0; p->a = i - i - c; p->f = AOT_N; if ((i & 0x0F) < (p->a & 0x0F) + c) p->f |= AOT_H; if (p->a == 0) p->f |= AOT_Z; if ((uint32_t)i - p->a - c > 0xFF) p->f |= AOT_C; }\n"
+    "static inline void aot_and(Processor * const p, uint8_t v) { p->a &= v; p->f = AOT_H; if (p->a == 0) p->f |= AOT_Z; }\n"
+    "static inline void aot_xor(Processor * const p, uint8_t v) { p->a ^= v; p->f = p->a == 0 ? AOT_Z : 0; }\n"
+    "static inline void aot_or(Processor * const p, uint8_t v) { p->a |= v; p->f = p->a == 0 ? AOT_Z : 0; }\n"
+    "static inline void aot_cp(Processor * const p, uint8_t v) { p->f = AOT_N; if ((p->a & 0x0F) < (v & 0x0F)) p->f |= AOT_H; if (p->a == v) p->f |= AOT_Z; if (p->a < v) p->f |= AOT_C; }\n"
+    "static inline uint8_t aot_inc(Processor * const p, uint8_t v) { v += 1; p->f &= AOT_C; if ((v & 0x0F) == 0) p->f |= AOT_H; if (v == 0) p->f |= AOT_Z; return v; }\n"
+    "static inline uint8_t aot_dec(Processor * const p, uint8_t v) { v -= 1; p->f &= AOT_C; p->f |= AOT_N; if ((v & 0x0F) == 0x0F) p->f |= AOT_H; if (v == 0) p->f |= AOT_Z; return v; }\n"
+    "static inline void aot_add_hl(Processor * const p, uint16_t v) { uint16_t i = p->hl; p->hl = i + v; p->f &= AOT_Z; if (((i & 0x0FFF) + (v & 0x0FFF)) & 0x1000) p->f |= AOT_H; if (((uint32_t)i + v) & 0x10000) p->f |= AOT_C; }\n"
+    "static inline uint16_t aot_add_sp(Processor * const p, int8_t v) { uint16_t i = p->sp; p->f = 0; if (((i & 0x000F) + (v & 0x000F)) > 0x000F) p->f |= AOT_H; if (((i & 0x00FF) + (v & 0x00FF)) > 0x00FF) p->f |= AOT_C; return i + v; }\n"
+    "static inline void aot_daa(Processor * const p) {\n"
+    "    if ((p->f & AOT_N) == 0) {\n"
+    "        if ((p->f & AOT_C) != 0 || p->a > 0x99) { p->a += 0x60; p->f |= AOT_C; }\n"
+    "        if ((p->f & AOT_H) != 0 || (p->a & 0x0F) > 0x09) p->a += 0x06;\n"
+    "    }\n"
+    "    else {\n"
+    "        if ((p->f & AOT_C) != 0) p->a -= 0x60;\n"
+    "        if ((p->f & AOT_H) != 0) p->a -= 0x06;\n"
+    "    }\n"
+    "    p->f ^= (-(p->a == 0) ^ p->f) & AOT_Z;\n"
+    "    p->f &= ~AOT_H;\n"
+    "}\n"
+    "static inline void aot_rlca(Processor * const p) { uint8_t c = p->a >> 7; p->a = (p->a << 1) | c; p->f = c ? AOT_C : 0; }\n"
+    "static inline void aot_rrca(Processor * const p) { uint8_t c = p->a & 1; p->a = (p->a >> 1) | (c << 7); p->f = c ? AOT_C : 0; }\n"
+    "static inline void aot_rla(Processor * const p) { uint8_t c = (p->f & AOT_C) != 0; p->f = (p->a & 0x80) ? AOT_C : 0; p->a = (p->a << 1) | c; }\n"
+    "static inline void aot_rra(Processor * const p) { uint8_t c = (p->f & AOT_C) != 0; p->f = (p->a & 0x01) ? AOT_C : 0; p->a = (p->a >> 1) | (c << 7); }\n"
+    "static inline uint8_t aot_shifted(Processor * const p, uint8_t v, bool carry) { p->f = carry ? AOT_C : 0; if (v == 0) p->f |= AOT_Z; return v; }\n"
+    "static inline uint8_t aot_rlc(Processor * const p, uint8_t v) { return aot_shifted(p, (v << 1) | (v >> 7), v & 0x80); }\n"
+    "static inline uint8_t aot_rrc(Processor * const p, uint8_t v) { return aot_shifted(p, (v >> 1) | (v << 7), v & 0x01); }\n"
+    "static inline uint8_t aot_rl(Processor * const p, uint8_t v) { return aot_shifted(p, (v << 1) | ((p->f & AOT_C) != 0), v & 0x80); }\n"
+    "static inline uint8_t aot_rr(Processor * const p, uint8_t v) { return aot_shifted(p, (v >> 1) | (((p->f & AOT_C) != 0) << 7), v & 0x01); }\n"
+    "static inline uint8_t aot_sla(Processor * const p, uint8_t v) { return aot_shifted(p, v << 1, v & 0x80); }\n"
+    "static inline uint8_t aot_sra(Processor * const p, uint8_t v) { return aot_shifted(p, (v >> 1) | (v & 0x80), v & 0x01); }\n"
+    "static inline uint8_t aot_swap(Processor * const p, uint8_t v) { return aot_shifted(p, (v >> 4) | (v << 4), false); }\n"
+    "static inline uint8_t aot_srl(Processor * const p, uint8_t v) { return aot_shifted(p, v >> 1, v & 0x01); }\n"
+    "static inline void aot_bit(Processor * const p, uint8_t mask, uint8_t v) { p->f &= AOT_C; p->f |= AOT_H; if ((v & mask) == 0) p->f |= AOT_Z; }\n"
+    "\n"
+    "#define AOT_EXIT(index, address) do { p->pc = (address); gb->scheduler->clock += cycles; return jumped ? PROCESSOR_NATIVE_JUMPED : (index) - entry; } while (0)\n"
+    "#define AOT_JUMP() do { gb->scheduler->clock += cycles; return PROCESSOR_NATIVE_JUMPED; } while (0)\n"
+    "\n";
+
+static bool aot_is_invalid(uint8_t opcode) {
+    switch (opcode) {
+        case 0xD3: case 0xDB: case 0xDD: case 0xE3: case 0xE4: case 0xEB: case 0xEC: case 0xED: case 0xF4: case 0xFC: case 0xFD:
+            return true;
+    }
+    return false;
+}
+
+// Longest path through an op in M-cycles, counting its fetch, zero when the module can't run it
+static uint8_t aot_get_cycles(uint8_t opcode, uint8_t cb) {
+    uint8_t x = (opcode >> 3) & 7;
+    uint8_t y = opcode & 7;
+
+    if (opcode == 0xCB) {
+        if ((cb & 7) != 6) return 2;
+        return (cb & 0xC0) == 0x40 ? 3 : 4;
+    }
+    if (opcode < 0x40) {
+        switch (y) {
+            case 0:
+                if (opcode == 0x00) return 1;
+                if (opcode == 0x08 || opcode == 0x10) return 0;
+                return 3;
+            case 1: return (opcode & 0x08) ? 2 : 3;
+            case 2: return 2;
+            case 3: return 2;
+            case 4: case 5: return x == 6 ? 3 : 1;
+            case 6: return x == 6 ? 3 : 2;
+            case 7: return 1;
+        }
+    }
+    if (opcode == 0x76) return 0;
+    if (opcode < 0x80) return x == 6 || y == 6 ? 2 : 1;
+    if (opcode < 0xC0) return y == 6 ? 2 : 1;
+
+    switch (opcode) {
+        case 0xC0: case 0xC8: case 0xD0: case 0xD8: return 5;
+        case 0xC1: case 0xD1: case 0xE1: case 0xF1: return 3;
+        case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA: return 4;
+        case 0xC4: case 0xCC: case 0xCD: case 0xD4: case 0xDC: return 6;
+        case 0xC5: case 0xD5: case 0xE5: case 0xF5: return 4;
+        case 0xC6: case 0xCE: case 0xD6: case 0xDE: case 0xE6: case 0xEE: case 0xF6: case 0xFE: return 2;
+        case 0xC7: case 0xCF: case 0xD7: case 0xDF: case 0xE7: case 0xEF: case 0xF7: case 0xFF: return 4;
+        case 0xC9: return 4;
+        case 0xE8: return 4;
+        case 0xE9: return 1;
+        case 0xEA: case 0xFA: return 4;
+        case 0xF3: return 1;
+        case 0xF8: return 3;
+        case 0xF9: return 2;
+    }
+    return 0;
+}
+
+// Whether execution never continues with the next op
+static bool aot_ends_flow(uint8_t opcode) {
+    switch (opcode) {
+        case 0x18: case 0xC3: case 0xC9: case 0xD9: case 0xE9: case 0xCD:
+        case 0xC7: case 0xCF: case 0xD7: case 0xDF: case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+            return true;
+    }
+    return aot_is_invalid(opcode);
+}
+
+// Conditional branches end the stretches a run checks the scheduler budget for
+static bool aot_is_conditional(uint8_t opcode) {
+    switch (opcode) {
+        case 0x20: case 0x28: case 0x30: case 0x38:
+        case 0xC0: case 0xC2: case 0xC4: case 0xC8: case 0xCA: case 0xCC:
+        case 0xD0: case 0xD2: case 0xD4: case 0xD8: case 0xDA: case 0xDC:
+            return true;
+    }
+    return false;
+}
+
+// Fixed target of a jump, call or restart, -1 when there is none
+static int32_t aot_get_target(AotOp const * const op) {
+    uint8_t opcode = op->opcode;
+    uint16_t next = op->address + op->length;
+    if (opcode == 0x18 || opcode == 0x20 || opcode == 0x28 || opcode == 0x30 || opcode == 0x38) return (uint16_t)(next + (int8_t)op->operands[0]);
+    switch (opcode) {
+        case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA:
+        case 0xC4: case 0xCC: case 0xCD: case 0xD4: case 0xDC:
+            return op->operands[0] | op->operands[1] << 8;
+        case 0xC7: case 0xCF: case 0xD7: case 0xDF: case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+            return opcode & 0x38;
+    }
+    return -1;
+}
+
+static void aot_push_seed(AotTool * const t, size_t bank, uint16_t address) {
+    if (t->seed_count == t->seed_capacity) {
+        t->seed_capacity = t->seed_capacity ? t->seed_capacity * 2 : 256;
+        t->seeds = realloc(t->seeds, t->seed_capacity * sizeof(AotSeed));
+        if (t->seeds == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    t->seeds[t->seed_count++] = (AotSeed){ bank, address };
+}
+
+// Queues code at an address reached from a bank, code in the switchable region could be in any bank when reached from bank 0
+static void aot_follow(AotTool * const t, size_t bank, uint16_t address) {
+    if (address < AOT_BANK_SIZE) {
+        aot_push_seed(t, 0, address);
+    }
+    else if (address < 2 * AOT_BANK_SIZE) {
+        if (bank != 0) aot_push_seed(t, bank, address);
+        else for (size_t i = 1; i < t->bank_count; i++) aot_push_seed(t, i, address);
+    }
+}
+
+static void aot_add_entry(AotTool * const t, AotOp const * const op, size_t index) {
+    if (t->entry_count == t->entry_capacity) {
+        t->entry_capacity = t->entry_capacity ? t->entry_capacity * 2 : 1024;
+        t->entries = realloc(t->entries, t->entry_capacity * sizeof(AotToolEntry));
+        if (t->entries == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    t->entries[t->entry_count++] = (AotToolEntry){ op->offset, op->address, index, op->worst, t->run_count };
+}
+
+static void aot_emit_read_page(AotTool * const t, char const * name, char const * address, AotOp const * const ops, size_t index) {
+    fprintf(t->out, "    { uint8_t const * const %s = gb->read_pages[(uint16_t)(%s) >> 8]; if (%s == NULL) AOT_EXIT(%zu, 0x%04X);\n", name, address, name, index, ops[index].address);
+}
+
+static void aot_emit_write_page(AotTool * const t, char const * name, char const * address, AotOp const * const ops, size_t index) {
+    fprintf(t->out, "    { uint8_t * const %s = gb->write_pages[(uint16_t)(%s) >> 8]; if (%s == NULL) AOT_EXIT(%zu, 0x%04X);\n", name, address, name, index, ops[index].address);
+}
+
+// Takes a branch to an op of the same run while nothing can fire before the next check
+static void aot_emit_local_jump(AotTool * const t, AotOp const * const ops, size_t target, uint16_t address) {
+    fprintf(t->out, "        jumped = true;\n");
+    fprintf(t->out, "        if (cycles + %u < budget) goto op_%zu;\n", ops[target].worst, target);
+    fprintf(t->out, "        p->pc = 0x%04X; AOT_JUMP();\n", address);
+}
+
+static void aot_emit_branch(AotTool * const t, AotOp const * const ops, size_t count, size_t index) {
+    AotOp const * const op = &ops[index];
+    uint8_t opcode = op->opcode;
+    uint16_t target = aot_get_target(op);
+    bool relative = opcode < 0xC0;
+    bool conditional = opcode != 0x18 && opcode != 0xC3;
+    uint8_t taken = relative ? 3 : 4;
+
+    size_t local = count;
+    for (size_t i = 0; i < count; i++) {
+        if (ops[i].address == target) local = i;
+    }
+
+    if (conditional) fprintf(t->out, "    if (%s) {\n", conditions[(opcode >> 3) & 3]);
+    else fprintf(t->out, "    {\n");
+    fprintf(t->out, "        cycles += %u;\n", taken);
+    if (local != count) aot_emit_local_jump(t, ops, local, target);
+    else fprintf(t->out, "        p->pc = 0x%04X; AOT_JUMP();\n", target);
+    fprintf(t->out, "    }\n");
+    if (conditional) fprintf(t->out, "    cycles += %u;\n", taken - 1);
+}
+
+static void aot_emit_push(AotTool * const t, char const * value, AotOp const * const ops, size_t index) {
+    aot_emit_write_page(t, "high", "p->sp - 1", ops, index);
+    aot_emit_write_page(t, "low", "p->sp - 2", ops, index);
+    fprintf(t->out, "    uint16_t v = %s; high[(uint8_t)(p->sp - 1)] = v >> 8; low[(uint8_t)(p->sp - 2)] = v; p->sp -= 2; }}\n", value);
+}
+
+static void aot_emit_pop(AotTool * const t, char const * target, AotOp const * const ops, size_t index) {
+    aot_emit_read_page(t, "low", "p->sp", ops, index);
+    aot_emit_read_page(t, "high", "p->sp + 1", ops, index);
+    fprintf(t->out, "    %s = low[(uint8_t)p->sp] | high[(uint8_t)(p->sp + 1)] << 8; p->sp += 2; }}\n", target);
+}
+
+// Emits one op, every path leaves it with its cycles added or through an exit
+static void aot_emit_op(AotTool * const t, AotOp const * const ops, size_t count, size_t index) {
+    AotOp const * const op = &ops[index];
+    FILE * const out = t->out;
+    uint8_t opcode = op->opcode;
+    uint8_t x = (opcode >> 3) & 7;
+    uint8_t y = opcode & 7;
+    uint8_t d8 = op->operands[0];
+    uint16_t d16 = op->operands[0] | op->operands[1] << 8;
+    char next[8];
+    char constant[8];
+    snprintf(next, sizeof(next), "0x%04X", (uint16_t)(op->address + op->length));
+    snprintf(constant, sizeof(constant), "0x%04X", d16);
+
+    fprintf(out, "op_%zu: // %04X: %02X", index, op->address, opcode);
+    for (size_t i = 1; i < op->length; i++) fprintf(out, " %02X", op->operands[i - 1]);
+    fprintf(out, "\n");
+    if (index > 0 && aot_is_conditional(ops[index - 1].opcode)) {
+        fprintf(out, "    if (cycles + %u >= budget) AOT_EXIT(%zu, 0x%04X);\n", op->worst, index, op->address);
+    }
+
+    if (opcode == 0xCB) {
+        uint8_t r = d8 & 7;
+        uint8_t n = (d8 >> 3) & 7;
+        char const * value = r == 6 ? "read[(uint8_t)p->hl]" : registers[r];
+        if (r == 6) {
+            aot_emit_read_page(t, "read", "p->hl", ops, index);
+            if ((d8 & 0xC0) != 0x40) aot_emit_write_page(t, "write", "p->hl", ops, index);
+        }
+        char const * store = r == 6 ? "write[(uint8_t)p->hl]" : registers[r];
+        switch (d8 >> 6) {
+            case 0: fprintf(out, "    %s = %s(p, %s);", store, shift_helpers[n], value); break;
+            case 1: fprintf(out, "    aot_bit(p, 0x%02X, %s);", 1 << n, value); break;
+            case 2: fprintf(out, "    %s = %s & 0x%02X;", store, value, (uint8_t)~(1 << n)); break;
+            case 3: fprintf(out, "    %s = %s | 0x%02X;", store, value, 1 << n); break;
+        }
+        if (r == 6) fprintf(out, (d8 & 0xC0) != 0x40 ? " }}" : " }");
+        fprintf(out, "\n    cycles += %u;\n", op->cycles);
+        return;
+    }
+
+    if (opcode == 0x00) {
+        fprintf(out, "    cycles += 1;\n");
+        return;
+    }
+    if (opcode < 0x40) {
+        if (y == 0 && opcode >= 0x18) {
+            aot_emit_branch(t, ops, count, index);
+            return;
+        }
+        if ((opcode & 0xCF) == 0x01) fprintf(out, "    %s = 0x%04X;\n", pairs[x >> 1], d16);
+        else if ((opcode & 0xCF) == 0x09) fprintf(out, "    aot_add_hl(p, %s);\n", pairs[x >> 1]);
+        else if ((opcode & 0xC7) == 0x02) {
+            char const * address = opcode < 0x20 ? pairs[x >> 1] : "p->hl";
+            if (opcode & 0x08) {
+                aot_emit_read_page(t, "read", address, ops, index);
+                fprintf(out, "    p->a = read[(uint8_t)%s]; }\n", address);
+            }
+            else {
+                aot_emit_write_page(t, "write", address, ops, index);
+                fprintf(out, "    write[(uint8_t)%s] = p->a; }\n", address);
+            }
+            if (opcode >= 0x20) fprintf(out, "    p->hl %s= 1;\n", opcode >= 0x30 ? "-" : "+");
+        }
+        else if ((opcode & 0xCF) == 0x03) fprintf(out, "    %s += 1;\n", pairs[x >> 1]);
+        else if ((opcode & 0xCF) == 0x0B) fprintf(out, "    %s -= 1;\n", pairs[x >> 1]);
+        else if (y == 4 || y == 5) {
+            char const * helper = y == 4 ? "aot_inc" : "aot_dec";
+            if (x == 6) {
+                aot_emit_read_page(t, "read", "p->hl", ops, index);
+                aot_emit_write_page(t, "write", "p->hl", ops, index);
+                fprintf(out, "    write[(uint8_t)p->hl] = %s(p, read[(uint8_t)p->hl]); }}\n", helper);
+            }
+            else {
+                fprintf(out, "    %s = %s(p, %s);\n", registers[x], helper, registers[x]);
+            }
+        }
+        else if (y == 6) {
+            if (x == 6) {
+                aot_emit_write_page(t, "write", "p->hl", ops, index);
+                fprintf(out, "    write[(uint8_t)p->hl] = 0x%02X; }\n", d8);
+            }
+            else {
+                fprintf(out, "    %s = 0x%02X;\n", registers[x], d8);
+            }
+        }
+        else {
+            static char const * const singles[8] = { "aot_rlca(p)", "aot_rrca(p)", "aot_rla(p)", "aot_rra(p)", "aot_daa(p)", "p->a ^= 0xFF; p->f |= AOT_N | AOT_H", "p->f = (p->f & AOT_Z) | AOT_C", "p->f = (p->f & (AOT_Z | AOT_C)) ^ AOT_C" };
+            fprintf(out, "    %s;\n", singles[x]);
+        }
+        fprintf(out, "    cycles += %u;\n", op->cycles);
+        return;
+    }
+
+    if (opcode < 0x80) {
+        if (y == 6) {
+            aot_emit_read_page(t, "read", "p->hl", ops, index);
+            fprintf(out, "    %s = read[(uint8_t)p->hl]; }\n", registers[x]);
+        }
+        else if (x == 6) {
+            aot_emit_write_page(t, "write", "p->hl", ops, index);
+            fprintf(out, "    write[(uint8_t)p->hl] = %s; }\n", registers[y]);
+        }
+        else if (x != y) {
+            fprintf(out, "    %s = %s;\n", registers[x], registers[y]);
+        }
+        fprintf(out, "    cycles += %u;\n", op->cycles);
+        return;
+    }
+
+    if (opcode < 0xC0 || (opcode & 0xC7) == 0xC6) {
+        // SBC A,A reads A back after writing it
+        if (opcode == 0x9F) fprintf(out, "    aot_sbc_a(p);\n");
+        else if (opcode >= 0xC0) fprintf(out, "    %s(p, 0x%02X);\n", alu_helpers[x], d8);
+        else if (y == 6) {
+            aot_emit_read_page(t, "read", "p->hl", ops, index);
+            fprintf(out, "    %s(p, read[(uint8_t)p->hl]); }\n", alu_helpers[x]);
+        }
+        else fprintf(out, "    %s(p, %s);\n", alu_helpers[x], registers[y]);
+        fprintf(out, "    cycles += %u;\n", op->cycles);
+        return;
+    }
+
+    switch (opcode) {
+        case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA:
+            aot_emit_branch(t, ops, count, index);
+            return;
+        case 0xC0: case 0xC8: case 0xD0: case 0xD8:
+            fprintf(out, "    if (%s) {\n", conditions[(opcode >> 3) & 3]);
+            aot_emit_pop(t, "p->pc", ops, index);
+            fprintf(out, "        cycles += 5; AOT_JUMP();\n    }\n    cycles += 2;\n");
+            return;
+        case 0xC9:
+            aot_emit_pop(t, "p->pc", ops, index);
+            fprintf(out, "    cycles += 4; AOT_JUMP();\n");
+            return;
+        case 0xC4: case 0xCC: case 0xD4: case 0xDC:
+            fprintf(out, "    if (%s) {\n", conditions[(opcode >> 3) & 3]);
+            aot_emit_push(t, next, ops, index);
+            fprintf(out, "        p->pc = 0x%04X; cycles += 6; AOT_JUMP();\n    }\n    cycles += 3;\n", d16);
+            break;
+        case 0xCD:
+            aot_emit_push(t, next, ops, index);
+            fprintf(out, "    p->pc = 0x%04X; cycles += 6; AOT_JUMP();\n", d16);
+            break;
+        case 0xC7: case 0xCF: case 0xD7: case 0xDF: case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+            aot_emit_push(t, next, ops, index);
+            fprintf(out, "    p->pc = 0x%04X; cycles += 4; AOT_JUMP();\n", opcode & 0x38);
+            break;
+        case 0xC1: case 0xD1: case 0xE1:
+            aot_emit_pop(t, stack_pairs[(opcode >> 4) & 3], ops, index);
+            fprintf(out, "    cycles += 3;\n");
+            return;
+        case 0xF1:
+            aot_emit_pop(t, "p->af", ops, index);
+            fprintf(out, "    p->af &= 0xFFF0;\n    cycles += 3;\n");
+            return;
+        case 0xC5: case 0xD5: case 0xE5: case 0xF5:
+            aot_emit_push(t, stack_pairs[(opcode >> 4) & 3], ops, index);
+            fprintf(out, "    cycles += 4;\n");
+            return;
+        case 0xE8:
+            fprintf(out, "    p->sp = aot_add_sp(p, (int8_t)0x%02X);\n    cycles += 4;\n", d8);
+            return;
+        case 0xE9:
+            fprintf(out, "    p->pc = p->hl; cycles += 1; AOT_JUMP();\n");
+            return;
+        case 0xEA:
+            aot_emit_write_page(t, "write", constant, ops, index);
+            fprintf(out, "    write[0x%02X] = p->a; }\n    cycles += 4;\n", d16 & 0xFF);
+            break;
+        case 0xFA:
+            aot_emit_read_page(t, "read", constant, ops, index);
+            fprintf(out, "    p->a = read[0x%02X]; }\n    cycles += 4;\n", d16 & 0xFF);
+            break;
+        case 0xF3:
+            fprintf(out, "    gb->interrupt_controller->ime = false;\n    gb->interrupt_controller->pending &= INTERRUPT_PENDING_EI;\n    cycles += 1;\n");
+            return;
+        case 0xF8:
+            fprintf(out, "    p->hl = aot_add_sp(p, (int8_t)0x%02X);\n    cycles += 3;\n", d8);
+            return;
+        case 0xF9:
+            fprintf(out, "    p->sp = p->hl;\n    cycles += 2;\n");
+            return;
+    }
+}
+
+// Walks the ops starting at a seed and emits them as one function when there are any
+static void aot_translate(AotTool * const t, size_t bank, uint16_t start) {
+    uint8_t const * const rom = t->cart->rom;
+    uint16_t limit = bank == 0 ? AOT_BANK_SIZE : 2 * AOT_BANK_SIZE;
+    size_t base = bank * AOT_BANK_SIZE - (bank == 0 ? 0 : AOT_BANK_SIZE);
+
+    AotOp ops[AOT_RUN_LENGTH];
+    size_t count = 0;
+    size_t total = 0;
+    uint16_t address = start;
+    while (count < AOT_RUN_LENGTH) {
+        size_t offset = base + address;
+        if (offset >= t->cart->rom_size) return;
+
+        uint8_t opcode = rom[offset];
+        size_t length = 1 + operand_lengths[opcode];
+        if (address + length > limit || offset + length > t->cart->rom_size) break;
+
+        AotOp * const op = &ops[count];
+        op->offset = offset;
+        op->address = address;
+        op->opcode = opcode;
+        op->length = length;
+        op->operands[0] = length > 1 ? rom[offset + 1] : 0;
+        op->operands[1] = length > 2 ? rom[offset + 2] : 0;
+        op->cycles = aot_get_cycles(opcode, op->operands[0]);
+
+        // The op after one the module can't run starts another run
+        if (op->cycles == 0 || total + op->cycles > AOT_RUN_CYCLES) {
+            if (op->cycles == 0 && !aot_ends_flow(opcode) && opcode != 0xD9) aot_follow(t, bank, address + length);
+            if (op->cycles != 0) aot_follow(t, bank, address);
+            break;
+        }
+        total += op->cycles;
+        count++;
+        address += length;
+
+        int32_t target = aot_get_target(op);
+        if (target >= 0) aot_follow(t, bank, target);
+        if (aot_ends_flow(opcode)) {
+            // Calls and restarts come back to the next op
+            if (target >= 0 && opcode != 0x18 && opcode != 0xC3) aot_follow(t, bank, address);
+            break;
+        }
+        if (count == AOT_RUN_LENGTH) aot_follow(t, bank, address);
+    }
+    if (count == 0) return;
+
+    for (size_t i = count; i-- > 0;) {
+        bool last = i == count - 1 || aot_is_conditional(ops[i].opcode);
+        ops[i].worst = ops[i].cycles + (last ? 0 : ops[i + 1].worst);
+    }
+
+    fprintf(t->out, "static size_t run_%zu(GameBoy * const gb, size_t entry) {\n", t->run_count);
+    fprintf(t->out, "    Processor * const p = gb->processor;\n");
+    fprintf(t->out, "    size_t cycles = 0;\n");
+    fprintf(t->out, "    bool jumped = false;\n");
+    fprintf(t->out, "    size_t const budget = gb->scheduler->next - gb->scheduler->clock;\n");
+    fprintf(t->out, "    switch (entry) {\n");
+    for (size_t i = 0; i < count; i++) fprintf(t->out, "        case %zu: goto op_%zu;\n", i, i);
+    fprintf(t->out, "    }\n");
+    for (size_t i = 0; i < count; i++) {
+        aot_emit_op(t, ops, count, i);
+        if (!t->covered[ops[i].offset]) {
+            t->covered[ops[i].offset] = true;
+            aot_add_entry(t, &ops[i], i);
+        }
+    }
+    AotOp const * const last = &ops[count - 1];
+    if (!aot_ends_flow(last->opcode)) fprintf(t->out, "    AOT_EXIT(%zu, 0x%04X);\n", count, (uint16_t)(last->address + last->length));
+    fprintf(t->out, "}\n\n");
+    t->run_count++;
+}
+
+static int aot_compare_entries(void const * a, void const * b) {
+    AotToolEntry const * const left = a;
+    AotToolEntry const * const right = b;
+    return (left->offset > right->offset) - (left->offset < right->offset);
+}
+
+static void aot_walk(AotTool * const t) {
+    // Entry point, restarts and interrupt vectors
+    aot_push_seed(t, 0, 0x0100);
+    for (uint16_t address = 0x00; address <= 0x60; address += 8) aot_push_seed(t, 0, address);
+
+    while (t->seed_count > 0) {
+        AotSeed seed = t->seeds[--t->seed_count];
+        size_t offset = seed.bank == 0 ? seed.address : seed.bank * AOT_BANK_SIZE + seed.address - AOT_BANK_SIZE;
+        if (offset >= t->cart->rom_size || t->visited[offset] || t->covered[offset]) continue;
+        t->visited[offset] = true;
+        aot_translate(t, seed.bank, seed.address);
+    }
+}
+
+static void aot_write_module(AotTool * const t) {
+    qsort(t->entries, t->entry_count, sizeof(AotToolEntry), aot_compare_entries);
+
+    fprintf(t->out, "static AotEntry const entries[] = {\n");
+    for (size_t i = 0; i < t->entry_count; i++) {
+        AotToolEntry const * const entry = &t->entries[i];
+        fprintf(t->out, "    { 0x%06X, 0x%04X, %u, %u, run_%zu },\n", entry->offset, entry->address, entry->entry, entry->cycles, entry->run);
+    }
+    if (t->entry_count == 0) fprintf(t->out, "    { 0 },\n");
+    fprintf(t->out, "};\n\n");
+
+    fprintf(t->out, "AotModule const %s = {\n", AOT_SYMBOL);
+    fprintf(t->out, "    AOT_VERSION,\n    AOT_LAYOUT,\n");
+    fprintf(t->out, "    0x%016llXull,\n", (unsigned long long)aot_hash(t->cart->rom, t->cart->rom_size));
+    fprintf(t->out, "    0x%zXull,\n", t->cart->rom_size);
+    fprintf(t->out, "    %zu,\n    entries,\n};\n", t->entry_count);
+}
+
+static void aot_usage(char const * name) {
+    fprintf(stderr, "Usage: %s [-k] [-I core_dir] [-o module] rom\n", name);
+    fprintf(stderr, "  -k  keep the generated C next to the module\n");
+    fprintf(stderr, "  -I  directory holding the core headers, defaults to %s\n", TRTLE_AOT_INCLUDE);
+    fprintf(stderr, "  -o  module to write, defaults to the ROM path with %s in place of its extension\n", AOT_EXTENSION);
+}
+
+int main(int argc, char ** argv) {
+    char const * rom_path = NULL;
+    char const * module_path = NULL;
+    char const * include = TRTLE_AOT_INCLUDE;
+    bool keep = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-k") == 0) keep = true;
+        else if (strcmp(argv[i], "-I") == 0 && i + 1 < argc) include = argv[++i];
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) module_path = argv[++i];
+        else if (argv[i][0] != '-' && rom_path == NULL) rom_path = argv[i];
+        else {
+            aot_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (rom_path == NULL) {
+        aot_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE * file = fopen(rom_path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Unable to open %s\n", rom_path);
+        return EXIT_FAILURE;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t * data = size > 0 ? malloc(size) : NULL;
+    if (data == NULL || fread(data, 1, size, file) != (size_t)size) {
+        fprintf(stderr, "Unable to read %s\n", rom_path);
+        fclose(file);
+        return EXIT_FAILURE;
+    }
+    fclose(file);
+
+    AotTool t = { 0 };
+    CartridgeError error = cartridge_from_memory(&t.cart, data, size);
+    free(data);
+    if (error) {
+        fprintf(stderr, "Unable to load %s: %i\n", rom_path, error);
+        return EXIT_FAILURE;
+    }
+    t.bank_count = t.cart->rom_size / AOT_BANK_SIZE;
+    t.visited = calloc(t.cart->rom_size, sizeof(bool));
+    t.covered = calloc(t.cart->rom_size, sizeof(bool));
+    if (t.visited == NULL || t.covered == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    // game.gb becomes game.aot.so
+    char * module = NULL;
+    if (module_path == NULL) {
+        char const * name = strrchr(rom_path, '/');
+        char const * extension = strrchr(name != NULL ? name : rom_path, '.');
+        size_t length = extension != NULL ? (size_t)(extension - rom_path) : strlen(rom_path);
+        module = malloc(length + sizeof(AOT_EXTENSION));
+        memcpy(module, rom_path, length);
+        memcpy(module + length, AOT_EXTENSION, sizeof(AOT_EXTENSION));
+        module_path = module;
+    }
+
+    size_t path_length = strlen(module_path);
+    char * source = malloc(path_length + 3);
+    memcpy(source, module_path, path_length);
+    memcpy(source + path_length, ".c", 3);
+
+    t.out = fopen(source, "w");
+    if (t.out == NULL) {
+        fprintf(stderr, "Unable to write %s\n", source);
+        return EXIT_FAILURE;
+    }
+    fprintf(t.out, "// Generated by trtle_aot from %s\n\n%s", rom_path, prelude);
+    aot_walk(&t);
+    aot_write_module(&t);
+    fclose(t.out);
+    printf("%zu runs covering %zu ops\n", t.run_count, t.entry_count);
+
+    char const * cc = getenv("CC");
+    if (cc == NULL || cc[0] == '\0') cc = "cc";
+    size_t command_length = strlen(cc) + strlen(include) + strlen(source) + path_length + 64;
+    char * command = malloc(command_length);
+    snprintf(command, command_length, "%s -O2 -shared -fPIC -I\"%s\" -o \"%s\" \"%s\"", cc, include, module_path, source);
+    int status = system(command);
+    if (status != 0) fprintf(stderr, "Compiling %s failed\n", source);
+    else if (!keep) remove(source);
+
+    free(command);
+    free(source);
+    free(module);
+    free(t.seeds);
+    free(t.entries);
+    free(t.visited);
+    free(t.covered);
+    cartridge_delete(t.cart);
+    return status == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
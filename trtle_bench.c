@@ -0,0 +1,146 @@
+// MBC benchmark, runs ROMs headless and prints the CPU time a frame takes:
+//
+//     trtle_bench [-f frames] [game.gb...]
+//
+// Without ROMs a built-in program runs once per MBC family. It writes a new ROM bank number, reads
+// from the bank it switched to and goes round again, so bank register writes make up the load. ROMs
+// given on the command line run instead with no input, each reported under its cartridge type.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cartridge.h"
+#include "gameboy.h"
+
+#define BENCH_FRAMES (3600)
+#define BENCH_FRAME  (17556) // M-cycles of a frame
+#define BENCH_BANKS  (4)
+
+typedef struct BenchFamily {
+    char const * name;
+    uint8_t type;
+} BenchFamily;
+
+static BenchFamily const bench_families[] = {
+    { "none", 0x00 },
+    { "mbc1", 0x01 },
+    { "mbc2", 0x05 },
+    { "mbc5", 0x19 }
+};
+
+// Switches between banks 1 to 3 through 2100, which every family takes as its ROM bank register
+static uint8_t const bench_program[] = {
+    0x06, 0x01,       //       LD B,1
+    0x78,             // loop: LD A,B
+    0xEA, 0x00, 0x21, //       LD (2100),A
+    0xFA, 0x00, 0x40, //       LD A,(4000)
+    0x04,             //       INC B
+    0x78,             //       LD A,B
+    0xE6, 0x03,       //       AND 3
+    0x20, 0x01,       //       JR NZ,skip
+    0x3C,             //       INC A
+    0x47,             // skip: LD B,A
+    0x18, 0xEF        //       JR loop
+};
+
+static bool bench_run(char const * name, uint8_t const * data, size_t size, long frames) {
+    Cartridge * cart = NULL;
+    CartridgeError error = cartridge_from_memory(&cart, data, size);
+    if (error) {
+        fprintf(stderr, "Unable to load %s: %i\n", name, error);
+        return false;
+    }
+
+    GameBoy * gb = gameboy_create();
+    gameboy_set_cartridge(gb, cart);
+    GameBoyInput input = { 0 };
+    clock_t start = clock();
+    for (long i = 0; i < frames; i++) gameboy_run_cycles(gb, input, BENCH_FRAME);
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("%02X %-24s %8.2f us/frame %8.0f frames/s\n", cart->type, name, seconds * 1e6 / frames, seconds > 0 ? frames / seconds : 0);
+
+    gameboy_delete(gb);
+    cartridge_delete(cart);
+    return true;
+}
+
+static bool bench_family(BenchFamily const * family, long frames) {
+    size_t size = BENCH_BANKS * 0x4000;
+    uint8_t * rom = calloc(1, size);
+    if (rom == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return false;
+    }
+    for (size_t bank = 1; bank < BENCH_BANKS; bank++) rom[bank * 0x4000] = bank;
+    memcpy(&rom[0x0100], (uint8_t const[]){ 0x00, 0xC3, 0x50, 0x01 }, 4); // NOP, JP 0150
+    rom[0x0147] = family->type;
+    rom[0x0148] = 0x01; // 64KiB
+    memcpy(&rom[0x0150], bench_program, sizeof(bench_program));
+
+    bool ok = bench_run(family->name, rom, size, frames);
+    free(rom);
+    return ok;
+}
+
+static bool bench_file(char const * path, long frames) {
+    FILE * file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Unable to open %s\n", path);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t * data = size > 0 ? malloc(size) : NULL;
+    if (data == NULL || fread(data, 1, size, file) != (size_t)size) {
+        fprintf(stderr, "Unable to read %s\n", path);
+        fclose(file);
+        free(data);
+        return false;
+    }
+    fclose(file);
+
+    bool ok = bench_run(path, data, size, frames);
+    free(data);
+    return ok;
+}
+
+static void bench_usage(char const * name) {
+    fprintf(stderr, "Usage: %s [-f frames] [rom...]\n", name);
+    fprintf(stderr, "  -f  frames to run each ROM for, defaults to %i\n", BENCH_FRAMES);
+}
+
+int main(int argc, char ** argv) {
+    long frames = BENCH_FRAMES;
+    int first_rom = argc;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) frames = atol(argv[++i]);
+        else if (argv[i][0] != '-') {
+            first_rom = i;
+            break;
+        }
+        else {
+            bench_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (frames <= 0) {
+        bench_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (first_rom == argc) {
+        for (size_t i = 0; i < sizeof(bench_families) / sizeof(bench_families[0]); i++) {
+            if (!bench_family(&bench_families[i], frames)) return EXIT_FAILURE;
+        }
+    }
+    for (int i = first_rom; i < argc; i++) {
+        if (!bench_file(argv[i], frames)) return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
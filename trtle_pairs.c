@@ -0,0 +1,153 @@
+// Op pair profiler, runs ROMs headless and prints the pairs worth fusing as PROCESSOR_FUSED_PAIRS:
+//
+//     trtle_pairs [-f frames] [-n pairs] game.gb...
+//
+// Only unprefixed ops running straight after each other in a decoded block are counted, the pairs a
+// fused handler could have run. Every ROM weighs the same however many ops it runs, and Start and A
+// are pressed in turn so title screens move on. Frames are counted in cycles rather than VBlanks, so
+// ROMs that turn the LCD off and wait still finish.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cartridge.h"
+#include "gameboy.h"
+#include "processor.h"
+#include "scheduler.h"
+
+#ifndef TRTLE_PAIR_PROFILE
+#error "trtle_pairs needs the core built with TRTLE_PAIR_PROFILE"
+#endif
+
+#define PAIRS_FRAMES (3600)
+#define PAIRS_COUNT  (16)
+#define PAIRS_PRESS  (30)    // Frames between input changes
+#define PAIRS_FRAME  (17556) // M-cycles of a frame
+
+typedef struct PairsEntry {
+    uint8_t first;
+    uint8_t second;
+    double share;
+} PairsEntry;
+
+static int pairs_compare(void const * a, void const * b) {
+    double x = ((PairsEntry const *)a)->share;
+    double y = ((PairsEntry const *)b)->share;
+    return (x < y) - (x > y);
+}
+
+// Adds the share of all the counted pairs each pair of the ROM makes up
+static bool pairs_profile(char const * path, long frames, double * shares) {
+    FILE * file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Unable to open %s\n", path);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t * data = size > 0 ? malloc(size) : NULL;
+    if (data == NULL || fread(data, 1, size, file) != (size_t)size) {
+        fprintf(stderr, "Unable to read %s\n", path);
+        fclose(file);
+        free(data);
+        return false;
+    }
+    fclose(file);
+
+    Cartridge * cart = NULL;
+    CartridgeError error = cartridge_from_memory(&cart, data, size);
+    free(data);
+    if (error) {
+        fprintf(stderr, "Unable to load %s: %i\n", path, error);
+        return false;
+    }
+
+    GameBoy * gb = gameboy_create();
+    gameboy_set_cartridge(gb, cart);
+    while (gb->scheduler->clock < (uint64_t)frames * PAIRS_FRAME) {
+        GameBoyInput input = { 0 };
+        uint64_t press = gb->scheduler->clock / PAIRS_FRAME / PAIRS_PRESS;
+        input.start = press % 4 == 1;
+        input.a = press % 4 == 3;
+        gameboy_update(gb, input);
+    }
+
+    uint64_t total = 0;
+    for (size_t i = 0; i < 256 * 256; i++) total += gb->processor->pair_counts[i / 256][i % 256];
+    for (size_t i = 0; i < 256 * 256 && total > 0; i++) shares[i] += (double)gb->processor->pair_counts[i / 256][i % 256] / total;
+    printf("// %s: %llu pairs in %ld frames\n", path, (unsigned long long)total, frames);
+
+    gameboy_delete(gb);
+    cartridge_delete(cart);
+    return true;
+}
+
+static void pairs_usage(char const * name) {
+    fprintf(stderr, "Usage: %s [-f frames] [-n pairs] rom...\n", name);
+    fprintf(stderr, "  -f  frames to run each ROM for, defaults to %i\n", PAIRS_FRAMES);
+    fprintf(stderr, "  -n  pairs to print, defaults to %i\n", PAIRS_COUNT);
+}
+
+int main(int argc, char ** argv) {
+    long frames = PAIRS_FRAMES;
+    long count = PAIRS_COUNT;
+    int first_rom = argc;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) frames = atol(argv[++i]);
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) count = atol(argv[++i]);
+        else if (argv[i][0] != '-') {
+            first_rom = i;
+            break;
+        }
+        else {
+            pairs_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (first_rom == argc || frames <= 0 || count <= 0) {
+        pairs_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    double * shares = calloc(256 * 256, sizeof(double));
+    PairsEntry * entries = calloc(256 * 256, sizeof(PairsEntry));
+    if (shares == NULL || entries == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    int roms = 0;
+    for (int i = first_rom; i < argc; i++) {
+        if (!pairs_profile(argv[i], frames, shares)) return EXIT_FAILURE;
+        roms++;
+    }
+
+    for (size_t i = 0; i < 256 * 256; i++) {
+        entries[i].first = i / 256;
+        entries[i].second = i % 256;
+        entries[i].share = shares[i] / roms;
+    }
+    qsort(entries, 256 * 256, sizeof(PairsEntry), pairs_compare);
+
+    double covered = 0;
+    for (long i = 0; i < count && entries[i].share > 0; i++) {
+        printf("// %02X %02X %6.2f%%\n", entries[i].first, entries[i].second, entries[i].share * 100);
+        covered += entries[i].share;
+    }
+    printf("// %.2f%% of the pairs run\n", covered * 100);
+
+    printf("#define PROCESSOR_FUSED_PAIRS(X)\\\n");
+    for (long i = 0; i < count && entries[i].share > 0; i++) {
+        bool last = i + 1 == count || entries[i + 1].share == 0;
+        printf("%s X(%02X, %02X)%s", i % 8 == 0 ? "   " : "", entries[i].first, entries[i].second, last ? "\n" : i % 8 == 7 ? "\\\n" : "");
+    }
+
+    free(entries);
+    free(shares);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,148 @@
+// Instruction timing check, runs ROMs headless in both timing modes and compares every frame:
+//
+//     trtle_timing [-f frames] game.gb... >> trtle_timing.txt
+//
+// A ROM whose frames all match prints its cartridge ID, the line the libretro core looks for in the
+// allow-list in its system directory. The rest print a comment naming the first frame that differed.
+// Both runs get the same input, Start and A pressed in turn so title screens move on.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cartridge.h"
+#include "gameboy.h"
+#include "ppu.h"
+#include "scheduler.h"
+
+#define TIMING_FRAMES (3600)
+#define TIMING_PRESS  (30)    // Frames between input changes
+#define TIMING_FRAME  (17556) // M-cycles of a frame
+
+typedef struct TimingRun {
+    Cartridge * cart;
+    GameBoy * gb;
+    uint32_t * display;
+} TimingRun;
+
+static uint8_t * timing_read(char const * path, long * size) {
+    FILE * file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Unable to open %s\n", path);
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    *size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t * data = *size > 0 ? malloc(*size) : NULL;
+    if (data == NULL || fread(data, 1, *size, file) != (size_t)*size) {
+        fprintf(stderr, "Unable to read %s\n", path);
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    return data;
+}
+
+static bool timing_start(TimingRun * const run, uint8_t const * data, long size, bool instruction_timing) {
+    if (cartridge_from_memory(&run->cart, data, size)) return false;
+    run->gb = gameboy_create();
+    run->display = calloc(GAMEBOY_DISPLAY_PIXEL_COUNT, sizeof(uint32_t));
+    if (run->gb == NULL || run->display == NULL) return false;
+    gameboy_set_cartridge(run->gb, run->cart);
+    gameboy_set_instruction_timing(run->gb, instruction_timing);
+    return true;
+}
+
+static void timing_stop(TimingRun * const run) {
+    gameboy_delete(run->gb);
+    cartridge_delete(run->cart);
+    free(run->display);
+}
+
+// Runs to the start of the next VBlank like gameboy_update_to_vblank, giving up after two frames
+// of cycles so ROMs that turn the LCD off and wait still move on
+static uint64_t timing_frame(TimingRun * const run, GameBoyInput input) {
+    GameBoy * const gb = run->gb;
+    uint64_t const limit = gb->scheduler->clock + 2 * TIMING_FRAME;
+    while (ppu_get_mode(gb) == GRAPHICS_MODE_VBLANK && gb->scheduler->clock < limit) gameboy_update(gb, input);
+    while (ppu_get_mode(gb) != GRAPHICS_MODE_VBLANK && gb->scheduler->clock < limit) gameboy_update(gb, input);
+
+    gameboy_get_display_data(gb, run->display, GAMEBOY_DISPLAY_PIXEL_COUNT);
+    uint64_t hash = 0xCBF29CE484222325u;
+    for (size_t i = 0; i < GAMEBOY_DISPLAY_PIXEL_COUNT; i++) hash = (hash ^ run->display[i]) * 0x100000001B3u;
+    return hash;
+}
+
+// Returns the first frame whose hashes differ, or frames when they all match
+static long timing_compare(uint8_t const * data, long size, long frames) {
+    TimingRun accurate = { 0 };
+    TimingRun instruction = { 0 };
+    long frame = -1;
+    if (timing_start(&accurate, data, size, false) && timing_start(&instruction, data, size, true)) {
+        for (frame = 0; frame < frames; frame++) {
+            GameBoyInput input = { 0 };
+            long press = frame / TIMING_PRESS;
+            input.start = press % 4 == 1;
+            input.a = press % 4 == 3;
+            if (timing_frame(&accurate, input) != timing_frame(&instruction, input)) break;
+        }
+    }
+    timing_stop(&accurate);
+    timing_stop(&instruction);
+    return frame;
+}
+
+static void timing_usage(char const * name) {
+    fprintf(stderr, "Usage: %s [-f frames] rom...\n", name);
+    fprintf(stderr, "  -f  frames to compare for each ROM, defaults to %i\n", TIMING_FRAMES);
+}
+
+int main(int argc, char ** argv) {
+    long frames = TIMING_FRAMES;
+    int first_rom = argc;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) frames = atol(argv[++i]);
+        else if (argv[i][0] != '-') {
+            first_rom = i;
+            break;
+        }
+        else {
+            timing_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (first_rom == argc || frames <= 0) {
+        timing_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int status = EXIT_SUCCESS;
+    for (int i = first_rom; i < argc; i++) {
+        long size = 0;
+        uint8_t * data = timing_read(argv[i], &size);
+        Cartridge * cart = NULL;
+        if (data == NULL || cartridge_from_memory(&cart, data, size)) {
+            fprintf(stderr, "Unable to load %s\n", argv[i]);
+            free(data);
+            status = EXIT_FAILURE;
+            continue;
+        }
+        char id[CARTRIDGE_ID_LENGTH];
+        cartridge_get_id(cart, id);
+        cartridge_delete(cart);
+
+        long frame = timing_compare(data, size, frames);
+        free(data);
+        if (frame == frames) printf("%s\n", id);
+        else if (frame < 0) {
+            fprintf(stderr, "Unable to run %s\n", argv[i]);
+            status = EXIT_FAILURE;
+        }
+        else printf("# %s: frame %ld of %s differs\n", id, frame, argv[i]);
+    }
+    return status;
+}